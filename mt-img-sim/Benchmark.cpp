@@ -0,0 +1,147 @@
+#include "Benchmark.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <spawn.h>
+#include <stdexcept>
+#include <sys/wait.h>
+
+namespace fs = std::filesystem;
+
+extern char** environ;
+
+namespace
+{
+constexpr double BYTES_IN_MEGABYTE = 1024.0 * 1024.0;
+
+// Процентиль методом ближайшего ранга: на малом числе повторов это просто
+// один из замеров, без интерполяции
+double GetPercentile(std::vector<double> values, double percentile)
+{
+	std::ranges::sort(values);
+	const auto rank = static_cast<size_t>(std::ceil(percentile / 100.0 * static_cast<double>(values.size())));
+	return values[std::clamp<size_t>(rank, 1, values.size()) - 1];
+}
+
+double GetMedian(std::vector<double> values)
+{
+	std::ranges::sort(values);
+	const size_t middle = values.size() / 2;
+	return values.size() % 2 ? values[middle] : (values[middle - 1] + values[middle]) / 2;
+}
+
+void AssertIsWritten(const std::ofstream& file, const std::string& filePath)
+{
+	if (!file)
+	{
+		throw std::runtime_error("Не удалось записать результаты: " + filePath);
+	}
+}
+} // namespace
+
+double RunThumbgen(const RunConfig& config, const Dataset& dataset, size_t threads, const std::string& pinMode)
+{
+	// Каждый запуск делает всю работу заново, а не досоздает миниатюры
+	fs::remove_all(config.outputDir);
+
+	std::vector<std::string> args = {config.thumbgenPath, dataset.dir, config.outputDir, "-j", std::to_string(threads)};
+	// none - поведение thumbgen по умолчанию, аргумент не нужен
+	if (pinMode != "none")
+	{
+		args.insert(args.end(), {"--pin", pinMode});
+	}
+	args.insert(args.end(), config.thumbgenArgs.begin(), config.thumbgenArgs.end());
+	std::vector<char*> argv;
+	for (auto& arg : args)
+	{
+		argv.push_back(arg.data());
+	}
+	argv.push_back(nullptr);
+
+	// Вывод thumbgen не нужен и не должен влиять на замер
+	posix_spawn_file_actions_t actions;
+	posix_spawn_file_actions_init(&actions);
+	posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+
+	const auto start = std::chrono::steady_clock::now();
+	pid_t pid = 0;
+	const int spawnError = posix_spawn(&pid, config.thumbgenPath.c_str(), &actions, nullptr, argv.data(), environ);
+	posix_spawn_file_actions_destroy(&actions);
+	if (spawnError != 0)
+	{
+		throw std::runtime_error("Не удалось запустить " + config.thumbgenPath);
+	}
+
+	int status = 0;
+	waitpid(pid, &status, 0);
+	const auto end = std::chrono::steady_clock::now();
+	if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+	{
+		throw std::runtime_error("thumbgen завершился с ошибкой при -j " + std::to_string(threads) + " --pin " + pinMode);
+	}
+	return std::chrono::duration<double, std::milli>(end - start).count();
+}
+
+PointStats MeasurePoint(const RunConfig& config, const Dataset& dataset, size_t threads, const std::string& pinMode, bool isCold, size_t repeats)
+{
+	PointStats point;
+	point.threads = threads;
+	point.pinMode = pinMode;
+	point.isCold = isCold;
+
+	if (!isCold)
+	{
+		RunThumbgen(config, dataset, threads, pinMode);
+	}
+	for (size_t i = 0; i < repeats; ++i)
+	{
+		if (isCold)
+		{
+			EvictFromPageCache(dataset);
+		}
+		point.timesMs.push_back(RunThumbgen(config, dataset, threads, pinMode));
+	}
+
+	point.medianMs = GetMedian(point.timesMs);
+	point.p95Ms = GetPercentile(point.timesMs, 95);
+	const double seconds = point.medianMs / 1000.0;
+	point.imagesPerSecond = static_cast<double>(dataset.files.size()) / seconds;
+	point.megabytesPerSecond = static_cast<double>(dataset.totalBytes) / BYTES_IN_MEGABYTE / seconds;
+	return point;
+}
+
+void WriteCsv(const std::string& filePath, const std::vector<PointStats>& points)
+{
+	std::ofstream file(filePath, std::ios::trunc);
+	file << "threads,pin,cache,runs,median_ms,p95_ms,images_per_s,mb_per_s\n";
+	for (const auto& point : points)
+	{
+		file << point.threads << "," << point.pinMode << "," << (point.isCold ? "cold" : "warm") << "," << point.timesMs.size() << ","
+			 << point.medianMs << "," << point.p95Ms << "," << point.imagesPerSecond << "," << point.megabytesPerSecond << "\n";
+	}
+	AssertIsWritten(file, filePath);
+}
+
+void WriteJson(const std::string& filePath, const Dataset& dataset, const std::vector<PointStats>& points)
+{
+	std::ofstream file(filePath, std::ios::trunc);
+	file << "{\"dataset\":{\"files\":" << dataset.files.size() << ",\"bytes\":" << dataset.totalBytes << "},\"points\":[";
+	for (size_t i = 0; i < points.size(); ++i)
+	{
+		const PointStats& point = points[i];
+		file << (i ? "," : "") << "{\"threads\":" << point.threads << ",\"pin\":\"" << point.pinMode << "\",\"cache\":\"" << (point.isCold ? "cold" : "warm")
+			 << "\",\"median_ms\":" << point.medianMs << ",\"p95_ms\":" << point.p95Ms
+			 << ",\"images_per_s\":" << point.imagesPerSecond << ",\"mb_per_s\":" << point.megabytesPerSecond << ",\"runs_ms\":[";
+		for (size_t j = 0; j < point.timesMs.size(); ++j)
+		{
+			file << (j ? "," : "") << point.timesMs[j];
+		}
+		file << "]}";
+	}
+	file << "]}\n";
+	AssertIsWritten(file, filePath);
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#pragma once
+
+#include "Dataset.h"
+
+#include <string>
+#include <vector>
+
+struct RunConfig
+{
+	std::string thumbgenPath;
+	std::string outputDir;
+	std::vector<std::string> thumbgenArgs;
+};
+
+struct PointStats
+{
+	size_t threads = 0;
+	std::string pinMode;
+	bool isCold = false;
+	std::vector<double> timesMs;
+	double medianMs = 0;
+	double p95Ms = 0;
+	double imagesPerSecond = 0;
+	double megabytesPerSecond = 0;
+};
+
+// Один запуск thumbgen на наборе с -j threads и --pin pinMode; время по
+// часам, с запуском процесса, как его видит пользователь
+double RunThumbgen(const RunConfig& config, const Dataset& dataset, size_t threads, const std::string& pinMode);
+// Холодные прогоны выталкивают набор из page cache перед каждым запуском,
+// теплые идут после одного незамеряемого прогрева
+PointStats MeasurePoint(const RunConfig& config, const Dataset& dataset, size_t threads, const std::string& pinMode, bool isCold, size_t repeats);
+
+void WriteCsv(const std::string& filePath, const std::vector<PointStats>& points);
+void WriteJson(const std::string& filePath, const Dataset& dataset, const std::vector<PointStats>& points);
\ No newline at end of file
@@ -0,0 +1,100 @@
+#include "Dataset.h"
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <unistd.h>
+#include <unordered_set>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+const std::unordered_set<std::string> IMG_EXTENSIONS = {".png", ".jpg", ".jpeg"};
+constexpr int JPEG_QUALITY = 90;
+
+// Градиент с шумом: JPEG такого изображения по размеру похож на фотографию,
+// а не сжимается в точку, как однотонная заливка
+std::vector<unsigned char> MakeImage(size_t seed, int width, int height)
+{
+	std::vector<unsigned char> pixels(static_cast<size_t>(width) * height * 3);
+	uint32_t state = static_cast<uint32_t>(seed) * 2654435761u + 1;
+	for (int y = 0; y < height; ++y)
+	{
+		for (int x = 0; x < width; ++x)
+		{
+			state = state * 1664525u + 1013904223u;
+			const int noise = static_cast<int>(state >> 27);
+			unsigned char* pixel = &pixels[(static_cast<size_t>(y) * width + x) * 3];
+			pixel[0] = static_cast<unsigned char>((x * 255 / width + noise + seed * 37) & 0xFF);
+			pixel[1] = static_cast<unsigned char>((y * 255 / height + noise) & 0xFF);
+			pixel[2] = static_cast<unsigned char>(((x + y) * 127 / (width + height) + noise * 2) & 0xFF);
+		}
+	}
+	return pixels;
+}
+} // namespace
+
+Dataset ScanDataset(const std::string& dir)
+{
+	if (!fs::is_directory(dir))
+	{
+		throw std::invalid_argument("Каталог с набором данных не найден: " + dir);
+	}
+
+	Dataset dataset;
+	dataset.dir = dir;
+	for (const auto& entry : fs::recursive_directory_iterator(dir))
+	{
+		if (entry.is_regular_file() && IMG_EXTENSIONS.contains(entry.path().extension().string()))
+		{
+			dataset.files.push_back(entry.path().string());
+			dataset.totalBytes += entry.file_size();
+		}
+	}
+	std::ranges::sort(dataset.files);
+
+	if (dataset.files.empty())
+	{
+		throw std::invalid_argument("В наборе данных нет изображений: " + dir);
+	}
+	return dataset;
+}
+
+void GenerateDataset(const std::string& dir, size_t count, int width, int height)
+{
+	fs::create_directories(dir);
+	for (size_t i = 0; i < count; ++i)
+	{
+		char name[32];
+		std::snprintf(name, sizeof(name), "img-%04zu.jpg", i);
+		const std::string filePath = (fs::path(dir) / name).string();
+		if (fs::exists(filePath))
+		{
+			continue;
+		}
+
+		const auto pixels = MakeImage(i, width, height);
+		if (!stbi_write_jpg(filePath.c_str(), width, height, 3, pixels.data(), JPEG_QUALITY))
+		{
+			throw std::runtime_error("Не удалось записать файл набора данных: " + filePath);
+		}
+	}
+}
+
+void EvictFromPageCache(const Dataset& dataset)
+{
+	for (const auto& filePath : dataset.files)
+	{
+		const int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+		if (fd < 0)
+		{
+			continue;
+		}
+		posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+		close(fd);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct Dataset
+{
+	std::string dir;
+	std::vector<std::string> files;
+	uint64_t totalBytes = 0;
+};
+
+Dataset ScanDataset(const std::string& dir);
+// Детерминированный набор JPEG: на любой машине получаются одни и те же
+// файлы, поэтому кривые можно сравнивать. Уже существующие не пересоздаются
+void GenerateDataset(const std::string& dir, size_t count, int width, int height);
+// Выталкивает файлы набора из page cache для холодного прогона
+void EvictFromPageCache(const Dataset& dataset);
\ No newline at end of file
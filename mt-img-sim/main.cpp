@@ -0,0 +1,257 @@
+#include "Benchmark.h"
+#include "Dataset.h"
+
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// Кривая "время от -j" для thumbgen: прогон по сетке числа потоков и режимов
+// закрепления, на каждой точке холодные и теплые повторы, итог в CSV и JSON
+namespace fs = std::filesystem;
+
+namespace
+{
+const std::string USAGE = "Ожидается: mt-img-sim DATASET_DIR [--threads 1,2,4,...] [--pin none,cores,threads] [--repeats N] [--csv FILE] [--json FILE] "
+						  "[--thumbgen PATH] [--output DIR] [--generate COUNT[:WxH]] [-- АРГУМЕНТЫ_THUMBGEN]";
+constexpr size_t DEFAULT_REPEATS = 5;
+constexpr int DEFAULT_GENERATED_WIDTH = 4000;
+constexpr int DEFAULT_GENERATED_HEIGHT = 3000;
+
+struct Options
+{
+	std::string datasetDir;
+	std::vector<size_t> threads;
+	std::vector<std::string> pinModes = {"none"};
+	size_t repeats = DEFAULT_REPEATS;
+	std::string csvPath = "mt-img-sim.csv";
+	std::string jsonPath = "mt-img-sim.json";
+	std::string thumbgenPath = THUMBGEN_PATH;
+	std::string outputDir = (fs::temp_directory_path() / ("mt-img-sim-" + std::to_string(getpid()))).string();
+	size_t generateCount = 0;
+	int generateWidth = DEFAULT_GENERATED_WIDTH;
+	int generateHeight = DEFAULT_GENERATED_HEIGHT;
+	std::vector<std::string> thumbgenArgs;
+};
+
+// Степени двойки до удвоенного числа ядер: видно и рост, и насыщение
+std::vector<size_t> GetDefaultThreads()
+{
+	const size_t limit = std::max<size_t>(2, 2 * std::thread::hardware_concurrency());
+	std::vector<size_t> threads;
+	for (size_t count = 1; count <= limit; count *= 2)
+	{
+		threads.push_back(count);
+	}
+	return threads;
+}
+
+std::vector<size_t> ParseThreads(const std::string& value)
+{
+	std::vector<size_t> threads;
+	size_t start = 0;
+	while (start <= value.size())
+	{
+		const size_t end = std::min(value.find(',', start), value.size());
+		const size_t count = std::stoul(value.substr(start, end - start));
+		if (count < 1)
+		{
+			throw std::invalid_argument("Число потоков должно быть положительным");
+		}
+		threads.push_back(count);
+		start = end + 1;
+	}
+	return threads;
+}
+
+std::vector<std::string> ParsePinModes(const std::string& value)
+{
+	std::vector<std::string> modes;
+	size_t start = 0;
+	while (start <= value.size())
+	{
+		const size_t end = std::min(value.find(',', start), value.size());
+		const std::string mode = value.substr(start, end - start);
+		if (mode != "none" && mode != "cores" && mode != "threads")
+		{
+			throw std::invalid_argument("Неизвестный режим --pin: " + mode + ". Ожидается none, cores или threads");
+		}
+		modes.push_back(mode);
+		start = end + 1;
+	}
+	return modes;
+}
+
+void ParseGenerate(const std::string& value, Options& options)
+{
+	const size_t sizePos = value.find(':');
+	options.generateCount = std::stoul(value.substr(0, sizePos));
+	if (sizePos != std::string::npos)
+	{
+		const std::string size = value.substr(sizePos + 1);
+		const size_t xPos = size.find('x');
+		if (xPos == std::string::npos)
+		{
+			throw std::invalid_argument("Неверный размер в --generate: " + size + ". Ожидается WxH");
+		}
+		options.generateWidth = std::stoi(size.substr(0, xPos));
+		options.generateHeight = std::stoi(size.substr(xPos + 1));
+	}
+	if (options.generateCount < 1 || options.generateWidth < 1 || options.generateHeight < 1)
+	{
+		throw std::invalid_argument("Неверное значение --generate: " + value);
+	}
+}
+
+bool IsWithin(const fs::path& path, const fs::path& dirPath)
+{
+	const fs::path relative = path.lexically_relative(dirPath);
+	return !relative.empty() && *relative.begin() != "..";
+}
+
+// Каталог результатов удаляется целиком перед каждым запуском и в конце,
+// поэтому в нем не должно быть ничего, кроме миниатюр этого прогона
+void CheckOutputDir(const Options& options)
+{
+	const fs::path outputDir = fs::weakly_canonical(options.outputDir);
+	const fs::path datasetDir = fs::weakly_canonical(options.datasetDir);
+	if (IsWithin(datasetDir, outputDir) || IsWithin(outputDir, datasetDir))
+	{
+		throw std::invalid_argument("Каталог --output не должен пересекаться с набором " + options.datasetDir + ": " + options.outputDir);
+	}
+	std::error_code error;
+	if (fs::exists(outputDir, error) && (!fs::is_directory(outputDir, error) || !fs::is_empty(outputDir, error)))
+	{
+		throw std::invalid_argument("Каталог --output уже существует и не пуст: " + options.outputDir);
+	}
+}
+
+Options ParseOptions(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		throw std::invalid_argument("Недостаточно аргументов. " + USAGE);
+	}
+
+	Options options;
+	options.datasetDir = argv[1];
+	for (int i = 2; i < argc; ++i)
+	{
+		const std::string arg = argv[i];
+		if (arg == "--")
+		{
+			options.thumbgenArgs.assign(argv + i + 1, argv + argc);
+			break;
+		}
+		if (i + 1 >= argc)
+		{
+			throw std::invalid_argument("Не указано значение для " + arg + ". " + USAGE);
+		}
+
+		const std::string value = argv[++i];
+		if (arg == "--threads")
+		{
+			options.threads = ParseThreads(value);
+		}
+		else if (arg == "--pin")
+		{
+			options.pinModes = ParsePinModes(value);
+		}
+		else if (arg == "--repeats")
+		{
+			options.repeats = std::stoul(value);
+		}
+		else if (arg == "--csv")
+		{
+			options.csvPath = value;
+		}
+		else if (arg == "--json")
+		{
+			options.jsonPath = value;
+		}
+		else if (arg == "--thumbgen")
+		{
+			options.thumbgenPath = value;
+		}
+		else if (arg == "--output")
+		{
+			options.outputDir = value;
+		}
+		else if (arg == "--generate")
+		{
+			ParseGenerate(value, options);
+		}
+		else
+		{
+			throw std::invalid_argument("Неизвестный аргумент: " + arg + ". " + USAGE);
+		}
+	}
+
+	if (options.repeats < 1)
+	{
+		throw std::invalid_argument("Число повторов должно быть положительным");
+	}
+	if (options.threads.empty())
+	{
+		options.threads = GetDefaultThreads();
+	}
+	if (options.thumbgenArgs.empty())
+	{
+		options.thumbgenArgs = {"--size", "256x256"};
+	}
+	CheckOutputDir(options);
+	return options;
+}
+
+void PrintPoint(const PointStats& point)
+{
+	std::cout << "-j " << point.threads << " --pin " << point.pinMode << (point.isCold ? " холодный" : " теплый")
+			  << ": медиана " << point.medianMs << " мс, p95 " << point.p95Ms << " мс, "
+			  << point.imagesPerSecond << " изобр/с, " << point.megabytesPerSecond << " МБ/с" << std::endl;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	try
+	{
+		const Options options = ParseOptions(argc, argv);
+		if (options.generateCount > 0)
+		{
+			GenerateDataset(options.datasetDir, options.generateCount, options.generateWidth, options.generateHeight);
+		}
+		const Dataset dataset = ScanDataset(options.datasetDir);
+		std::cout << "Набор: " << dataset.files.size() << " файлов, " << dataset.totalBytes << " байт" << std::endl;
+
+		const RunConfig config{options.thumbgenPath, options.outputDir, options.thumbgenArgs};
+		std::vector<PointStats> points;
+		// Режимы закрепления идут рядом на каждой точке -j, чтобы их было
+		// удобно сравнивать
+		for (const size_t threads : options.threads)
+		{
+			for (const auto& pinMode : options.pinModes)
+			{
+				for (const bool isCold : {true, false})
+				{
+					points.push_back(MeasurePoint(config, dataset, threads, pinMode, isCold, options.repeats));
+					PrintPoint(points.back());
+				}
+			}
+		}
+		fs::remove_all(options.outputDir);
+
+		WriteCsv(options.csvPath, points);
+		WriteJson(options.jsonPath, dataset, points);
+		std::cout << "Результаты: " << options.csvPath << ", " << options.jsonPath << std::endl;
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
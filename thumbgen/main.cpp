@@ -1,15 +1,129 @@
 #include "ArgParser.h"
+#include "AtlasBuilder.h"
+#include "BufferArena.h"
+#include "ContentHash.h"
+#include "CpuTopology.h"
 #include "DirectoryScanner.h"
+#include "DirectoryWatcher.h"
+#include "ErrorLog.h"
 #include "ImageProcessor.h"
+#include "InFlightFiles.h"
+#include "Manifest.h"
+#include "Pipeline.h"
+#include "Progress.h"
+#include "ResizeCache.h"
+#include "StageStats.h"
+#include "TaskOrder.h"
+#include "WorkStealingPool.h"
 
 #include <atomic>
-#include <boost/asio/post.hpp>
-#include <boost/asio/thread_pool.hpp>
+#include <csignal>
 #include <filesystem>
 #include <iostream>
+#include <optional>
+#include <semaphore>
 
 namespace fs = std::filesystem;
 const std::unordered_set<std::string> IMG_EXTENSIONS = {".png", ".jpg", ".jpeg"};
+const std::string MANIFEST_FILE_NAME = ".thumbgen-manifest";
+// Сколько задач на поток может ждать в очереди пула, пока обход идет дальше
+constexpr size_t SUBMIT_SLOTS_PER_THREAD = 4;
+// Меняется вместе с форматом результата, чтобы инкрементальный режим
+// пересобрал миниатюры, сделанные прежней версией
+const std::string OUTPUT_FORMAT_VERSION = "1";
+// Трассировка хранит столько последних событий каждого потока
+constexpr size_t TRACE_EVENTS_PER_THREAD = 64 * 1024;
+// Как часто --progress обновляет строку в терминале
+constexpr std::chrono::milliseconds PROGRESS_INTERVAL{250};
+
+// В режиме слежения работа идет до SIGINT/SIGTERM
+std::atomic<bool> g_isStopRequested = false;
+
+void RequestStop(int)
+{
+	g_isStopRequested = true;
+}
+
+InputOptions GetInputOptions(const ArgParser& parser)
+{
+	InputOptions options;
+	if (parser.GetInputMode() == "mmap")
+	{
+		options.mode = InputMode::Mmap;
+	}
+	else if (parser.GetInputMode() == "pread")
+	{
+		options.mode = InputMode::Pread;
+	}
+	options.populate = parser.IsInputPopulate();
+	options.sequential = parser.IsInputSequential();
+	options.hashContent = parser.GetIncrementalMode() == "hash";
+	return options;
+}
+
+std::vector<ImageProcessor::OutputSpec> GetOutputSpecs(const ArgParser& parser)
+{
+	std::vector<ImageProcessor::OutputSpec> outputs;
+	for (const auto& size : parser.GetSizes())
+	{
+		outputs.push_back({{size.width, size.height}, size.layout});
+	}
+	return outputs;
+}
+
+PinMode GetPinMode(const ArgParser& parser)
+{
+	if (parser.GetPinMode() == "cores")
+	{
+		return PinMode::Cores;
+	}
+	return parser.GetPinMode() == "threads" ? PinMode::Threads : PinMode::None;
+}
+
+TaskOrder GetTaskOrder(const ArgParser& parser)
+{
+	if (parser.GetOrder() == "lpt")
+	{
+		return TaskOrder::LargestFirst;
+	}
+	return parser.GetOrder() == "spt" ? TaskOrder::SmallestFirst : TaskOrder::Directory;
+}
+
+// Раскладка потоков пула по процессорам; пустая, если закрепление не нужно
+std::vector<int> GetPoolPlacement(const CpuTopology& topology, size_t numThreads, PinMode mode)
+{
+	const std::vector<int> placement = topology.GetPlacement(mode, numThreads);
+	if (!placement.empty() && numThreads > topology.GetCoreCount())
+	{
+		std::cerr << "Потоков больше, чем физических ядер (" << topology.GetCoreCount() << "): часть из них делит ядро" << std::endl;
+	}
+	return placement;
+}
+
+void PinPoolThread(const CpuTopology& topology, int cpu)
+{
+	if (PinCurrentThread(cpu))
+	{
+		BufferArena::SetThreadNode(topology.GetNode(cpu));
+	}
+	else
+	{
+		std::cerr << "Не удалось закрепить поток за процессором " << cpu << std::endl;
+	}
+}
+
+// Миниатюры, записанные отдельными файлами, не попадают в пакеты и наоборот,
+// а от числа пакетов зависит, в каком пакете лежит запись файла
+uint64_t GetParamsHash(const std::vector<ImageProcessor::OutputSpec>& outputs, size_t packCount)
+{
+	std::string params = OUTPUT_FORMAT_VERSION;
+	params += ";pack=" + std::to_string(packCount);
+	for (const auto& output : outputs)
+	{
+		params += ";" + std::to_string(output.maxSize.width) + "x" + std::to_string(output.maxSize.height) + ":" + output.layout;
+	}
+	return HashContent(params.data(), params.size());
+}
 
 int main(int argc, char* argv[])
 {
@@ -19,49 +133,453 @@ int main(int argc, char* argv[])
 	{
 		ArgParser parser(argc, argv);
 		parser.Parse();
+		if (!parser.GetStatsPath().empty())
+		{
+			StageStats::Enable();
+		}
+		if (!parser.GetTracePath().empty())
+		{
+			StageStats::EnableTrace(TRACE_EVENTS_PER_THREAD);
+		}
+		if (parser.IsProgress())
+		{
+			Progress::Enable();
+		}
 
-		auto files = DirectoryScanner::Scan(parser.GetInputDir(), IMG_EXTENSIONS);
-		std::sort(files.begin(), files.end());
-
-		boost::asio::thread_pool pool(parser.GetNumThreads());
 		std::atomic<int> processedCount = 0;
 		std::atomic<int> failedCount = 0;
+		std::atomic<int> exifPreviewCount = 0;
+		std::atomic<int> duplicateCount = 0;
 
-		const int thumbW = parser.GetThumbWidth();
-		const int thumbH = parser.GetThumbHeight();
+		const auto outputs = GetOutputSpecs(parser);
 		const std::string inputDirStr = parser.GetInputDir();
 		const std::string outputDirStr = parser.GetOutputDir();
+		const InputOptions inputOptions = GetInputOptions(parser);
 
-		for (const auto& filePathStr : files)
+		std::optional<Manifest> manifest;
+		if (!parser.GetIncrementalMode().empty())
 		{
-			boost::asio::post(pool, [&, filePathStr] {
-				try
+			manifest.emplace(
+				(fs::path(outputDirStr) / MANIFEST_FILE_NAME).string(),
+				GetParamsHash(outputs, parser.GetPackCount()),
+				parser.GetIncrementalMode() == "hash");
+		}
+
+		// В инкрементальном режиме пакеты дописываются: записи неизмененных
+		// файлов остаются от прошлого запуска
+		std::optional<PackWriter> packWriter;
+		if (parser.GetPackCount() > 0)
+		{
+			packWriter.emplace(outputDirStr, static_cast<uint32_t>(parser.GetPackCount()), manifest.has_value());
+		}
+
+		std::optional<AtlasBuilder> atlas;
+		if (parser.GetAtlasSize() > 0)
+		{
+			atlas.emplace(inputDirStr, outputDirStr, outputs, parser.GetAtlasSize());
+		}
+
+		// Декодирование крупных изображений ждет памяти, а не множится с -j
+		std::optional<MemoryBudget> memoryBudget;
+		if (parser.GetMaxMemory() > 0)
+		{
+			memoryBudget.emplace(parser.GetMaxMemory());
+			BufferArena::LimitCache(parser.GetMaxMemory());
+		}
+
+		std::optional<DedupTable> dedupTable;
+		if (parser.IsDedup())
+		{
+			dedupTable.emplace();
+		}
+
+		// В режиме слежения у файла не больше одной задачи за раз
+		std::optional<InFlightFiles> inFlight;
+		if (parser.IsWatch())
+		{
+			inFlight.emplace();
+		}
+		auto removeOutputs = [&](const std::string& filePathStr) {
+			ImageProcessor::RemoveOutputs(filePathStr, inputDirStr, outputDirStr, outputs);
+			if (manifest)
+			{
+				manifest->Forget(filePathStr, inputDirStr);
+			}
+		};
+		auto onFinished = [&](const std::string& filePathStr) {
+			if (inFlight && inFlight->Finish(filePathStr) == InFlightFiles::Action::Remove)
+			{
+				removeOutputs(filePathStr);
+			}
+		};
+
+		auto onDone = [&](const std::string& filePathStr, const ImageProcessor::TaskResult& result) {
+			if (result.source == ImageProcessor::ThumbnailSource::ExifPreview)
+			{
+				++exifPreviewCount;
+			}
+			else if (result.source == ImageProcessor::ThumbnailSource::Duplicate)
+			{
+				++duplicateCount;
+			}
+			if (manifest)
+			{
+				manifest->MarkDone(filePathStr, result.contentHash);
+			}
+			++processedCount;
+			Progress::AddFinished();
+			onFinished(filePathStr);
+		};
+		// Рабочие потоки не ждут stderr: ошибки пишет поток журнала
+		ErrorLog errorLog(parser.GetErrorLogPath());
+		auto onError = [&](const std::string& filePathStr, const std::exception& e) {
+			errorLog.Report(filePathStr, e);
+			++failedCount;
+			Progress::AddFinished();
+			onFinished(filePathStr);
+		};
+
+		// Подписка оформляется до обхода, чтобы не потерять файлы, пришедшие
+		// во время него
+		std::optional<DirectoryWatcher> watcher;
+		if (parser.IsWatch())
+		{
+			watcher.emplace(inputDirStr, IMG_EXTENSIONS);
+			std::signal(SIGINT, RequestStop);
+			std::signal(SIGTERM, RequestStop);
+		}
+
+		// Файлы уходят в обработку по мере обхода; неизменные в инкрементальном
+		// режиме отсеиваются сразу
+		using Submit = std::function<void(const std::string&)>;
+		auto filterChanged = [&](const Submit& submit) {
+			return [&](const std::string& filePathStr) {
+				if (!manifest || manifest->IsChanged(filePathStr, inputDirStr))
+				{
+					// Файл уже в работе: его поставит заново TakeRestarts
+					if (inFlight && !inFlight->TryStart(filePathStr))
+					{
+						return;
+					}
+					if (Progress::IsEnabled())
+					{
+						std::error_code error;
+						const uintmax_t size = fs::file_size(filePathStr, error);
+						Progress::AddQueued(error ? 0 : static_cast<size_t>(size));
+					}
+					submit(filePathStr);
+				}
+			};
+		};
+		// Неизменные файлы отсеиваются до упорядочивания, чтобы размеры
+		// не запрашивались у них зря
+		auto walk = [&](const Submit& submit) {
+			SubmitInOrder(
+				GetTaskOrder(parser),
+				[&](const Submit& onFile) {
+					if (parser.GetScanThreads() > 1)
+					{
+						DirectoryScanner::ParallelWalk(inputDirStr, IMG_EXTENSIONS, parser.GetScanThreads(), filterChanged(onFile));
+					}
+					else
+					{
+						DirectoryScanner::Walk(inputDirStr, IMG_EXTENSIONS, parser.IsSorted(), filterChanged(onFile));
+					}
+				},
+				submit);
+		};
+		std::optional<Progress::Reporter> progress;
+		if (parser.IsProgress())
+		{
+			progress.emplace(PROGRESS_INTERVAL);
+		}
+		auto onWalkDone = [&] {
+			if (progress)
+			{
+				progress->SetWalkDone();
+			}
+		};
+		// После начального обхода новые и измененные файлы приходят от
+		// inotify, а у удаленных убираются миниатюры
+		auto watch = [&](const Submit& submit) {
+			if (!watcher)
+			{
+				return;
+			}
+			std::cout << "Ожидание изменений в " << inputDirStr << std::endl;
+			const auto onChanged = filterChanged(submit);
+			watcher->Run(
+				onChanged,
+				[&](const std::string& filePathStr) {
+					if (inFlight->TryRemove(filePathStr))
+					{
+						removeOutputs(filePathStr);
+					}
+				},
+				[&] {
+					for (const auto& filePathStr : inFlight->TakeRestarts())
+					{
+						onChanged(filePathStr);
+					}
+				},
+				g_isStopRequested);
+		};
+
+		const auto& stageThreads = parser.GetStageThreads();
+		if (!stageThreads.empty())
+		{
+			PipelineConfig config;
+			config.readThreads = stageThreads[0];
+			config.decodeThreads = stageThreads[1];
+			config.resizeThreads = stageThreads[2];
+			config.encodeThreads = stageThreads[3];
+			config.writeThreads = stageThreads[4];
+			config.input = inputOptions;
+			config.dedupTable = dedupTable ? &*dedupTable : nullptr;
+			config.packWriter = packWriter ? &*packWriter : nullptr;
+			config.memoryBudget = memoryBudget ? &*memoryBudget : nullptr;
+
+			Pipeline pipeline(config, outputs);
+			pipeline.Run(
+				[&](const Submit& submit) {
+					walk(submit);
+					onWalkDone();
+					watch(submit);
+				},
+				inputDirStr,
+				outputDirStr,
+				[&](const ImageProcessor::ThumbnailTask& task) {
+					onDone(task.inputPath, {task.source, task.contentHash});
+				},
+				onError);
+		}
+		else
+		{
+			const size_t numThreads = parser.GetNumThreads();
+			const size_t submitSlotCount = numThreads * SUBMIT_SLOTS_PER_THREAD;
+			std::counting_semaphore<> submitSlots(static_cast<std::ptrdiff_t>(submitSlotCount));
+			std::atomic<size_t> queuedCount = 0;
+			std::atomic<bool> isWalkDone = false;
+			const CpuTopology topology = CpuTopology::Detect();
+			const std::vector<int> placement = GetPoolPlacement(topology, numThreads, GetPinMode(parser));
+			WorkStealingPool pool(numThreads, [&](size_t workerIndex) {
+				if (!placement.empty())
+				{
+					PinPoolThread(topology, placement[workerIndex]);
+				}
+			});
+
+			// Чтение и запись идут пачками через io_uring в отдельном потоке, а
+			// потокам пула остаются декодирование, масштабирование и кодирование
+			std::optional<AsyncIo> asyncIo;
+			if (parser.GetIoMode() == "uring")
+			{
+				if (IoRing::IsSupported())
 				{
-					ImageProcessor::ProcessTask(
-						filePathStr,
-						inputDirStr,
-						outputDirStr,
-						thumbW,
-						thumbH);
-
-					++processedCount;
+					asyncIo.emplace(submitSlotCount);
 				}
-				catch (const std::exception& e)
+				else
 				{
-					std::cerr << "Ошибка при обработке файла " << filePathStr << ": " << e.what() << std::endl;
-					++failedCount;
+					std::cerr << "io_uring недоступен, используется блокирующий ввод-вывод" << std::endl;
 				}
+			}
+
+			// Свободные потоки пула помогают масштабировать крупные изображения
+			// и хвост очереди, когда брать новые файлы уже некому
+			ResizeCache::EnableSplitting(static_cast<int>(numThreads), [&pool](std::function<void()> helper) {
+				pool.Post(std::move(helper));
 			});
+
+			// Сюда результат приходит из потока ввода-вывода, когда миниатюры записаны
+			const auto onAsyncDone = [&](const std::string& filePathStr, const ImageProcessor::TaskResult& result, std::exception_ptr error) {
+				if (!error)
+				{
+					onDone(filePathStr, result);
+				}
+				else
+				{
+					try
+					{
+						std::rethrow_exception(error);
+					}
+					catch (const std::exception& e)
+					{
+						onError(filePathStr, e);
+					}
+				}
+				submitSlots.release();
+			};
+			const auto processRead = [&](const std::string& filePathStr, std::unique_ptr<SourceFile> file, std::exception_ptr readError) {
+				try
+				{
+					if (readError)
+					{
+						StageStats::MarkFailed(StageStats::Stage::Read, filePathStr);
+						std::rethrow_exception(readError);
+					}
+					auto task = ImageProcessor::MakeTask(filePathStr, inputDirStr, outputDirStr, outputs);
+					task.sourceFile = std::move(file);
+					if (inputOptions.hashContent)
+					{
+						ImageProcessor::HashSource(task);
+					}
+					ImageProcessor::ProcessTaskAsync(
+						std::move(task),
+						*asyncIo,
+						[&, filePathStr](const ImageProcessor::TaskResult& result, std::exception_ptr error) {
+							onAsyncDone(filePathStr, result, error);
+						},
+						dedupTable ? &*dedupTable : nullptr,
+						memoryBudget ? &*memoryBudget : nullptr);
+				}
+				catch (const std::exception&)
+				{
+					onAsyncDone(filePathStr, {}, std::current_exception());
+				}
+			};
+
+			const auto submit = [&](const std::string& filePathStr) {
+				submitSlots.acquire();
+				++queuedCount;
+				if (asyncIo)
+				{
+					asyncIo->Read(filePathStr, [&, filePathStr](std::unique_ptr<SourceFile> file, std::exception_ptr readError) {
+						// Слот файла должен вернуться, даже если задачу не удалось поставить
+						try
+						{
+							pool.Post([&, filePathStr, file = std::move(file), readError]() mutable {
+								ResizeCache::HelpPendingResizes();
+								ResizeCache::SetRunningDry(--queuedCount < numThreads && isWalkDone);
+								processRead(filePathStr, std::move(file), readError);
+							});
+						}
+						catch (const std::exception&)
+						{
+							--queuedCount;
+							onAsyncDone(filePathStr, {}, std::current_exception());
+						}
+					});
+					return;
+				}
+				if (atlas)
+				{
+					atlas->Assign(filePathStr);
+				}
+				pool.Post([&, filePathStr] {
+					ResizeCache::HelpPendingResizes();
+					ResizeCache::SetRunningDry(--queuedCount < numThreads && isWalkDone);
+					try
+					{
+						if (atlas)
+						{
+							auto task = ImageProcessor::RenderTask(filePathStr, inputDirStr, outputDirStr, outputs, inputOptions, memoryBudget ? &*memoryBudget : nullptr);
+							atlas->Add(task);
+							onDone(filePathStr, {task.source, task.contentHash});
+						}
+						else
+						{
+							onDone(filePathStr, ImageProcessor::ProcessTask(
+								filePathStr,
+								inputDirStr,
+								outputDirStr,
+								outputs,
+								inputOptions,
+								dedupTable ? &*dedupTable : nullptr,
+								packWriter ? &*packWriter : nullptr,
+								memoryBudget ? &*memoryBudget : nullptr));
+						}
+					}
+					catch (const std::exception& e)
+					{
+						if (atlas)
+						{
+							atlas->Skip(filePathStr);
+						}
+						onError(filePathStr, e);
+					}
+					submitSlots.release();
+				});
+			};
+			walk(submit);
+			onWalkDone();
+			isWalkDone = true;
+			ResizeCache::SetRunningDry(queuedCount < numThreads);
+			watch(submit);
+
+			// Пул не знает о чтениях и записях в кольце: ждем, пока каждый файл
+			// вернет свой слот
+			if (asyncIo)
+			{
+				for (size_t i = 0; i < submitSlotCount; ++i)
+				{
+					submitSlots.acquire();
+				}
+			}
+			pool.Join();
+			ResizeCache::DisableSplitting();
 		}
 
-		pool.join();
+		errorLog.Close();
+		if (progress)
+		{
+			progress->Stop();
+		}
+		if (atlas)
+		{
+			atlas->Finish();
+		}
+
+		// Манифест не должен считать готовыми миниатюры, которых нет в индексе
+		if (packWriter)
+		{
+			packWriter->Save();
+		}
+		if (manifest)
+		{
+			manifest->Save();
+		}
 
 		std::cout << "Обработано = " << processedCount << std::endl;
+		if (manifest)
+		{
+			std::cout << "Пропущено без изменений = " << manifest->GetSkippedCount() << std::endl;
+		}
 		std::cout << "Ошибок = " << failedCount << std::endl;
+		if (atlas)
+		{
+			std::cout << "Атласов = " << atlas->GetAtlasCount() << std::endl;
+		}
+		std::cout << "Из превью EXIF = " << exifPreviewCount << std::endl;
+		if (dedupTable)
+		{
+			std::cout << "Дубликатов = " << duplicateCount << std::endl;
+		}
+
+		if (memoryBudget)
+		{
+			std::cout << "Пик бюджета памяти = " << memoryBudget->GetPeakUsage() / (1024 * 1024) << " МБ из " << memoryBudget->GetLimit() / (1024 * 1024) << " МБ" << std::endl;
+		}
+
+		const auto arenaStats = BufferArena::GetStats();
+		std::cout << "Выделений памяти у системы = " << arenaStats.systemAllocations
+				  << " (на изображение " << static_cast<double>(arenaStats.systemAllocations) / std::max(1, processedCount.load())
+				  << ", переиспользовано " << arenaStats.reusedAllocations << ")" << std::endl;
 
 		auto endTime = std::chrono::high_resolution_clock::now();
 		auto duration = std::chrono::duration_cast<std::chrono::milliseconds>(endTime - startTime);
 		std::cout << "Общее время: " << duration.count() << " мс" << std::endl;
+
+		if (!parser.GetStatsPath().empty())
+		{
+			StageStats::WriteReport(parser.GetStatsPath(), {
+				std::chrono::duration<double, std::milli>(endTime - startTime).count(),
+				static_cast<size_t>(processedCount.load()),
+				static_cast<size_t>(failedCount.load())});
+		}
+		if (!parser.GetTracePath().empty())
+		{
+			StageStats::WriteTrace(parser.GetTracePath());
+		}
 	}
 	catch (const std::exception& e)
 	{
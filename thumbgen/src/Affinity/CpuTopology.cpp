@@ -0,0 +1,135 @@
+#include "CpuTopology.h"
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <pthread.h>
+#include <sched.h>
+#include <string>
+#include <tuple>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+const fs::path CPU_SYSFS_DIR = "/sys/devices/system/cpu";
+
+int ReadNumber(const fs::path& filePath, int defaultValue)
+{
+	std::ifstream file(filePath);
+	int value = 0;
+	return file >> value ? value : defaultValue;
+}
+
+// Каталог процессора содержит ссылку nodeN на свой узел
+int ReadNode(const fs::path& cpuDir)
+{
+	std::error_code error;
+	for (const auto& entry : fs::directory_iterator(cpuDir, error))
+	{
+		const std::string name = entry.path().filename().string();
+		if (name.starts_with("node") && name.size() > 4 && std::isdigit(static_cast<unsigned char>(name[4])))
+		{
+			return std::stoi(name.substr(4));
+		}
+	}
+	return 0;
+}
+} // namespace
+
+CpuTopology CpuTopology::Detect()
+{
+	cpu_set_t allowed;
+	CPU_ZERO(&allowed);
+	if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+	{
+		CPU_ZERO(&allowed);
+		CPU_SET(0, &allowed);
+	}
+
+	CpuTopology topology;
+	for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+	{
+		if (!CPU_ISSET(cpu, &allowed))
+		{
+			continue;
+		}
+		const fs::path cpuDir = CPU_SYSFS_DIR / ("cpu" + std::to_string(cpu));
+		LogicalCpu info;
+		info.id = cpu;
+		info.core = ReadNumber(cpuDir / "topology" / "core_id", cpu);
+		info.package = ReadNumber(cpuDir / "topology" / "physical_package_id", 0);
+		info.node = ReadNode(cpuDir);
+		topology.m_cpus.push_back(info);
+	}
+
+	// Номер среди соседей по ядру: 0 у первого логического процессора ядра
+	std::map<std::pair<int, int>, int> siblingsSeen;
+	for (auto& cpu : topology.m_cpus)
+	{
+		cpu.siblingIndex = siblingsSeen[{cpu.package, cpu.core}]++;
+	}
+	return topology;
+}
+
+std::vector<int> CpuTopology::GetPlacement(PinMode mode, size_t count) const
+{
+	if (mode == PinMode::None || m_cpus.empty())
+	{
+		return {};
+	}
+
+	std::vector<LogicalCpu> order = m_cpus;
+	if (mode == PinMode::Threads)
+	{
+		std::ranges::sort(order, {}, [](const LogicalCpu& cpu) {
+			return std::tuple(cpu.node, cpu.package, cpu.core, cpu.siblingIndex);
+		});
+	}
+	else
+	{
+		// Ранг ядра внутри своего узла: ядра с одинаковым рангом с разных
+		// узлов идут подряд
+		std::map<std::tuple<int, int, int>, int> coreRanks;
+		std::map<int, int> coresPerNode;
+		for (const auto& cpu : order)
+		{
+			const auto key = std::tuple(cpu.node, cpu.package, cpu.core);
+			if (!coreRanks.contains(key))
+			{
+				coreRanks[key] = coresPerNode[cpu.node]++;
+			}
+		}
+		std::ranges::sort(order, {}, [&](const LogicalCpu& cpu) {
+			return std::tuple(cpu.siblingIndex, coreRanks.at({cpu.node, cpu.package, cpu.core}), cpu.node);
+		});
+	}
+
+	std::vector<int> placement;
+	for (size_t i = 0; i < count; ++i)
+	{
+		placement.push_back(order[i % order.size()].id);
+	}
+	return placement;
+}
+
+int CpuTopology::GetNode(int cpu) const
+{
+	const auto it = std::ranges::find(m_cpus, cpu, &LogicalCpu::id);
+	return it != m_cpus.end() ? it->node : 0;
+}
+
+size_t CpuTopology::GetCoreCount() const
+{
+	return static_cast<size_t>(std::ranges::count(m_cpus, 0, &LogicalCpu::siblingIndex));
+}
+
+bool PinCurrentThread(int cpu)
+{
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+}
\ No newline at end of file
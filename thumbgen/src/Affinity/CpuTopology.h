@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+enum class PinMode
+{
+	None,
+	// Сначала по одному потоку на физическое ядро, по очереди с разных узлов
+	// NUMA; соседи по SMT - только когда ядра кончились
+	Cores,
+	// Логические процессоры подряд: узел за узлом, соседи по SMT рядом
+	Threads,
+};
+
+// Процессоры, доступные процессу, с ядром, сокетом и узлом NUMA из
+// /sys/devices/system/cpu. Без sysfs каждый процессор считается отдельным
+// ядром единственного узла.
+class CpuTopology
+{
+public:
+	static CpuTopology Detect();
+
+	// Процессор для каждого из count потоков; пустой при PinMode::None.
+	// Потоков больше, чем процессоров, - раскладка идет по кругу
+	std::vector<int> GetPlacement(PinMode mode, size_t count) const;
+	int GetNode(int cpu) const;
+	size_t GetCoreCount() const;
+
+private:
+	struct LogicalCpu
+	{
+		int id = 0;
+		int core = 0;
+		int package = 0;
+		int node = 0;
+		int siblingIndex = 0;
+	};
+
+	std::vector<LogicalCpu> m_cpus;
+};
+
+// false, если ядро отказало (процессор вне cgroup или выключен)
+bool PinCurrentThread(int cpu);
\ No newline at end of file
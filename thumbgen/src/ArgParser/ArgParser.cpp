@@ -1,13 +1,20 @@
 #include "ArgParser.h"
+#include "TextUtils.h"
+#include <set>
 #include <stdexcept>
 
 namespace
 {
+const std::string SINGLE_SIZE_LAYOUT = "{dir}/{name}{ext}";
+const std::string MULTI_SIZE_LAYOUT = "{w}x{h}/{dir}/{name}{ext}";
+// Все пакеты открыты одновременно, так что их число ограничено дескрипторами
+constexpr size_t MAX_PACK_COUNT = 256;
+
 void AssertMinArgsValid(const std::vector<std::string>& args)
 {
 	if (args.size() < 2)
 	{
-		throw std::invalid_argument("Недостаточно аргументов. Ожидается: thumbgen INPUT_DIR OUTPUT_DIR --size=WxH -j NUM_THREADS");
+		throw std::invalid_argument("Недостаточно аргументов. Ожидается: thumbgen INPUT_DIR OUTPUT_DIR --size WxH[:LAYOUT] [--size ...] -j NUM_THREADS [--stages R,D,S,E,W] [--input stream|mmap|pread[,populate][,sequential]] [--incremental mtime|hash] [--dedup] [--sorted] [--scan-threads N] [--watch] [--progress] [--io blocking|uring] [--pack N] [--atlas N] [--stats FILE] [--trace FILE] [--error-log FILE] [--max-memory SIZE[K|M|G]] [--pin none|cores|threads] [--order dir|lpt|spt]");
 	}
 }
 
@@ -18,10 +25,86 @@ void AssertIsNumberThreadsValid(size_t numThreads)
 		throw std::invalid_argument("Количество потоков должно быть не меньше 1");
 	}
 }
+
+// std::stoul принимает "-1" и заворачивает его в огромное число
+size_t ParseUnsigned(const std::string& value)
+{
+	if (value.find('-') != std::string::npos)
+	{
+		throw std::invalid_argument("Ожидается неотрицательное число: " + value);
+	}
+	return std::stoul(value);
+}
+
+// --name=value равнозначно --name value
+std::vector<std::string> SplitAssignments(const std::vector<std::string>& args)
+{
+	std::vector<std::string> result;
+	for (size_t i = 0; i < args.size(); ++i)
+	{
+		const size_t assignPos = args[i].find('=');
+		if (i >= 2 && args[i].starts_with("--") && assignPos != std::string::npos)
+		{
+			result.push_back(args[i].substr(0, assignPos));
+			result.push_back(args[i].substr(assignPos + 1));
+		}
+		else
+		{
+			result.push_back(args[i]);
+		}
+	}
+	return result;
+}
+
+size_t ParseMemorySize(const std::string& sizeStr)
+{
+	size_t suffixPos = 0;
+	const size_t value = std::stoul(sizeStr, &suffixPos);
+	const std::string suffix = sizeStr.substr(suffixPos);
+	size_t multiplier = 1;
+	if (suffix == "K" || suffix == "k")
+	{
+		multiplier = size_t(1) << 10;
+	}
+	else if (suffix == "M" || suffix == "m")
+	{
+		multiplier = size_t(1) << 20;
+	}
+	else if (suffix == "G" || suffix == "g")
+	{
+		multiplier = size_t(1) << 30;
+	}
+	else if (!suffix.empty())
+	{
+		throw std::invalid_argument("Неизвестная единица --max-memory: " + suffix + ". Ожидается K, M или G");
+	}
+	if (value == 0)
+	{
+		throw std::invalid_argument("Бюджет --max-memory должен быть положительным");
+	}
+	return value * multiplier;
+}
+
+// Разные размеры не должны писать в один и тот же файл
+void AssertLayoutsDistinct(const std::vector<SizeOption>& sizes)
+{
+	std::set<std::string> layouts;
+	for (const auto& size : sizes)
+	{
+		const std::string layout = ReplaceAll(
+			ReplaceAll(size.layout, "{w}", std::to_string(size.width)),
+			"{h}",
+			std::to_string(size.height));
+		if (!layouts.insert(layout).second)
+		{
+			throw std::invalid_argument("Несколько размеров --size пишут по одному шаблону: " + size.layout);
+		}
+	}
+}
 } // namespace
 
 ArgParser::ArgParser(int argc, char* argv[])
-	: m_args(argv + 1, argv + argc)
+	: m_args(SplitAssignments({argv + 1, argv + argc}))
 {
 	AssertMinArgsValid(m_args);
 }
@@ -44,20 +127,155 @@ void ArgParser::Parse()
 		{
 			ParseSize(GetValueFor(arg, i));
 		}
+		else if (arg == "--stages")
+		{
+			ParseStageThreads(GetValueFor(arg, i));
+		}
+		else if (arg == "--input")
+		{
+			ParseInput(GetValueFor(arg, i));
+		}
+		else if (arg == "--incremental")
+		{
+			ParseIncremental(GetValueFor(arg, i));
+		}
+		else if (arg == "--dedup")
+		{
+			m_dedup = true;
+		}
+		else if (arg == "--sorted")
+		{
+			m_sorted = true;
+		}
+		else if (arg == "--scan-threads")
+		{
+			m_scanThreads = std::stoul(GetValueFor(arg, i));
+			AssertIsNumberThreadsValid(m_scanThreads);
+		}
+		else if (arg == "--watch")
+		{
+			m_watch = true;
+		}
+		else if (arg == "--progress")
+		{
+			m_progress = true;
+		}
+		else if (arg == "--pack")
+		{
+			m_packCount = ParseUnsigned(GetValueFor(arg, i));
+			if (m_packCount < 1 || m_packCount > MAX_PACK_COUNT)
+			{
+				throw std::invalid_argument("Число пакетов --pack должно быть от 1 до " + std::to_string(MAX_PACK_COUNT));
+			}
+		}
+		else if (arg == "--atlas")
+		{
+			m_atlasSize = ParseUnsigned(GetValueFor(arg, i));
+			if (m_atlasSize < 1)
+			{
+				throw std::invalid_argument("Размер группы --atlas должен быть положительным");
+			}
+		}
+		else if (arg == "--stats")
+		{
+			m_statsPath = GetValueFor(arg, i);
+		}
+		else if (arg == "--trace")
+		{
+			m_tracePath = GetValueFor(arg, i);
+		}
+		else if (arg == "--error-log")
+		{
+			m_errorLogPath = GetValueFor(arg, i);
+		}
+		else if (arg == "--max-memory")
+		{
+			m_maxMemory = ParseMemorySize(GetValueFor(arg, i));
+		}
+		else if (arg == "--pin")
+		{
+			m_pinMode = GetValueFor(arg, i);
+			if (m_pinMode != "none" && m_pinMode != "cores" && m_pinMode != "threads")
+			{
+				throw std::invalid_argument("Неизвестный режим --pin: " + m_pinMode + ". Ожидается none, cores или threads");
+			}
+		}
+		else if (arg == "--order")
+		{
+			m_order = GetValueFor(arg, i);
+			if (m_order != "dir" && m_order != "lpt" && m_order != "spt")
+			{
+				throw std::invalid_argument("Неизвестный порядок --order: " + m_order + ". Ожидается dir, lpt или spt");
+			}
+		}
+		else if (arg == "--io")
+		{
+			m_ioMode = GetValueFor(arg, i);
+			if (m_ioMode != "blocking" && m_ioMode != "uring")
+			{
+				throw std::invalid_argument("Неизвестный режим --io: " + m_ioMode + ". Ожидается blocking или uring");
+			}
+		}
 		else
 		{
 			throw std::invalid_argument("Неизвестный аргумент: " + arg);
 		}
 	}
 
-	if (m_thumbWidth == 0 || m_thumbHeight == 0)
+	if (m_sizes.empty())
+	{
+		throw std::invalid_argument("Аргумент --size WxH является обязательным");
+	}
+	ApplyDefaultLayouts();
+	AssertLayoutsDistinct(m_sizes);
+
+	if (m_sorted && m_scanThreads > 1)
+	{
+		throw std::invalid_argument("Аргумент --sorted несовместим с параллельным обходом --scan-threads");
+	}
+	if (m_ioMode == "uring" && !m_stageThreads.empty())
+	{
+		throw std::invalid_argument("Аргумент --io uring несовместим с --stages");
+	}
+	// Индекс пакетов сохраняется один раз в конце, а запись через io_uring
+	// идет мимо WriteOutput
+	if (m_packCount > 0 && (m_watch || m_ioMode == "uring"))
+	{
+		throw std::invalid_argument("Аргумент --pack несовместим с --watch и --io uring");
+	}
+	// Атлас собирается из пикселей всех файлов группы: пропущенные
+	// неизмененные файлы и дубликаты без декодирования в него бы не попали
+	if (m_atlasSize > 0 && (!m_stageThreads.empty() || m_packCount > 0 || m_ioMode == "uring" || m_watch || m_dedup || !m_incrementalMode.empty()))
+	{
+		throw std::invalid_argument("Аргумент --atlas несовместим с --stages, --pack, --io uring, --watch, --dedup и --incremental");
+	}
+	// Потоки конвейера создаются по стадиям, закрепляются только потоки пула
+	if (m_pinMode != "none" && !m_stageThreads.empty())
 	{
-		throw std::invalid_argument("Аргумент --size=WxH является обязательным");
+		throw std::invalid_argument("Аргумент --pin несовместим с --stages");
+	}
+	// Таблица дубликатов только растет и ссылается на миниатюры, которые при
+	// слежении могут быть удалены или перезаписаны
+	if (m_watch && m_dedup)
+	{
+		throw std::invalid_argument("Аргумент --watch несовместим с --dedup");
 	}
 }
 
-void ArgParser::ParseSize(const std::string& sizeStr)
+void ArgParser::ParseSize(const std::string& sizeArg)
 {
+	const size_t layoutPos = sizeArg.find(':');
+	const std::string sizeStr = sizeArg.substr(0, layoutPos);
+	SizeOption size;
+	if (layoutPos != std::string::npos)
+	{
+		size.layout = sizeArg.substr(layoutPos + 1);
+		if (size.layout.empty())
+		{
+			throw std::invalid_argument("Пустой шаблон пути в --size: " + sizeArg);
+		}
+	}
+
 	size_t delimiterPos = sizeStr.find('x');
 	if (delimiterPos == std::string::npos)
 	{
@@ -74,18 +292,102 @@ void ArgParser::ParseSize(const std::string& sizeStr)
 
 	try
 	{
-		m_thumbWidth = std::stoi(widthStr);
-		m_thumbHeight = std::stoi(heightStr);
+		size.width = std::stoi(widthStr);
+		size.height = std::stoi(heightStr);
 	}
 	catch (const std::exception& _)
 	{
 		throw std::invalid_argument("Не удалось распознать --size как числа: " + sizeStr);
 	}
 
-	if (m_thumbWidth <= 0 || m_thumbHeight <= 0)
+	if (size.width <= 0 || size.height <= 0)
 	{
 		throw std::invalid_argument("Размеры --size (WxH) должны быть положительными числами");
 	}
+	m_sizes.push_back(std::move(size));
+}
+
+// С одним размером результат лежит как раньше, рядом с исходной структурой
+// каталогов; с несколькими каждый размер по умолчанию в своем подкаталоге
+void ArgParser::ApplyDefaultLayouts()
+{
+	const std::string& defaultLayout = m_sizes.size() == 1 ? SINGLE_SIZE_LAYOUT : MULTI_SIZE_LAYOUT;
+	for (auto& size : m_sizes)
+	{
+		if (size.layout.empty())
+		{
+			size.layout = defaultLayout;
+		}
+	}
+}
+
+void ArgParser::ParseStageThreads(const std::string& stagesStr)
+{
+	m_stageThreads.clear();
+	size_t start = 0;
+	while (start <= stagesStr.size())
+	{
+		size_t delimiterPos = stagesStr.find(',', start);
+		if (delimiterPos == std::string::npos)
+		{
+			delimiterPos = stagesStr.size();
+		}
+
+		try
+		{
+			m_stageThreads.push_back(std::stoul(stagesStr.substr(start, delimiterPos - start)));
+		}
+		catch (const std::exception& _)
+		{
+			throw std::invalid_argument("Не удалось распознать --stages как числа: " + stagesStr);
+		}
+		AssertIsNumberThreadsValid(m_stageThreads.back());
+		start = delimiterPos + 1;
+	}
+
+	if (m_stageThreads.size() != PIPELINE_STAGES)
+	{
+		throw std::invalid_argument("Аргумент --stages ожидает число потоков для 5 стадий: чтение,декодирование,масштабирование,кодирование,запись");
+	}
+}
+
+void ArgParser::ParseInput(const std::string& inputStr)
+{
+	size_t start = 0;
+	size_t delimiterPos = inputStr.find(',');
+	m_inputMode = inputStr.substr(0, delimiterPos);
+	if (m_inputMode != "stream" && m_inputMode != "mmap" && m_inputMode != "pread")
+	{
+		throw std::invalid_argument("Неизвестный режим --input: " + m_inputMode + ". Ожидается stream, mmap или pread");
+	}
+
+	while (delimiterPos != std::string::npos)
+	{
+		start = delimiterPos + 1;
+		delimiterPos = inputStr.find(',', start);
+		const std::string option = inputStr.substr(start, delimiterPos - start);
+		if (option == "populate")
+		{
+			m_inputPopulate = true;
+		}
+		else if (option == "sequential")
+		{
+			m_inputSequential = true;
+		}
+		else
+		{
+			throw std::invalid_argument("Неизвестная опция --input: " + option);
+		}
+	}
+}
+
+void ArgParser::ParseIncremental(const std::string& modeStr)
+{
+	if (modeStr != "mtime" && modeStr != "hash")
+	{
+		throw std::invalid_argument("Неизвестный режим --incremental: " + modeStr + ". Ожидается mtime или hash");
+	}
+	m_incrementalMode = modeStr;
 }
 
 const std::string& ArgParser::GetValueFor(const std::string& argName, size_t& index)
@@ -113,12 +415,102 @@ size_t ArgParser::GetNumThreads() const
 	return m_numThreads;
 }
 
-int ArgParser::GetThumbWidth() const
+const std::vector<SizeOption>& ArgParser::GetSizes() const
+{
+	return m_sizes;
+}
+
+const std::vector<size_t>& ArgParser::GetStageThreads() const
+{
+	return m_stageThreads;
+}
+
+const std::string& ArgParser::GetInputMode() const
+{
+	return m_inputMode;
+}
+
+bool ArgParser::IsInputPopulate() const
+{
+	return m_inputPopulate;
+}
+
+bool ArgParser::IsInputSequential() const
+{
+	return m_inputSequential;
+}
+
+const std::string& ArgParser::GetIncrementalMode() const
+{
+	return m_incrementalMode;
+}
+
+bool ArgParser::IsDedup() const
+{
+	return m_dedup;
+}
+
+bool ArgParser::IsSorted() const
+{
+	return m_sorted;
+}
+
+size_t ArgParser::GetScanThreads() const
+{
+	return m_scanThreads;
+}
+
+bool ArgParser::IsWatch() const
+{
+	return m_watch;
+}
+
+bool ArgParser::IsProgress() const
+{
+	return m_progress;
+}
+
+const std::string& ArgParser::GetIoMode() const
+{
+	return m_ioMode;
+}
+
+size_t ArgParser::GetPackCount() const
+{
+	return m_packCount;
+}
+
+size_t ArgParser::GetAtlasSize() const
+{
+	return m_atlasSize;
+}
+
+const std::string& ArgParser::GetStatsPath() const
+{
+	return m_statsPath;
+}
+
+const std::string& ArgParser::GetTracePath() const
+{
+	return m_tracePath;
+}
+
+const std::string& ArgParser::GetErrorLogPath() const
+{
+	return m_errorLogPath;
+}
+
+size_t ArgParser::GetMaxMemory() const
+{
+	return m_maxMemory;
+}
+
+const std::string& ArgParser::GetPinMode() const
 {
-	return m_thumbWidth;
+	return m_pinMode;
 }
 
-int ArgParser::GetThumbHeight() const
+const std::string& ArgParser::GetOrder() const
 {
-	return m_thumbHeight;
+	return m_order;
 }
\ No newline at end of file
@@ -3,9 +3,19 @@
 #include <string>
 #include <vector>
 
+// Размер миниатюры и шаблон пути результата относительно OUTPUT_DIR.
+// В шаблоне подставляются {dir}, {name}, {ext}, {w} и {h}.
+struct SizeOption
+{
+	int width = 0;
+	int height = 0;
+	std::string layout;
+};
+
 class ArgParser
 {
 	constexpr static size_t MIN_THREADS = 1;
+	constexpr static size_t PIPELINE_STAGES = 5;
 
 public:
 	ArgParser(int argc, char* argv[]);
@@ -14,17 +24,63 @@ public:
 	const std::string& GetInputDir() const;
 	const std::string& GetOutputDir() const;
 	size_t GetNumThreads() const;
-	int GetThumbWidth() const;
-	int GetThumbHeight() const;
+	const std::vector<SizeOption>& GetSizes() const;
+	const std::vector<size_t>& GetStageThreads() const;
+	const std::string& GetInputMode() const;
+	bool IsInputPopulate() const;
+	bool IsInputSequential() const;
+	const std::string& GetIncrementalMode() const;
+	bool IsDedup() const;
+	bool IsSorted() const;
+	size_t GetScanThreads() const;
+	bool IsWatch() const;
+	bool IsProgress() const;
+	const std::string& GetIoMode() const;
+	// 0, если миниатюры пишутся отдельными файлами
+	size_t GetPackCount() const;
+	// 0, если атласы не собираются
+	size_t GetAtlasSize() const;
+	// Пустой, если отчет по стадиям не нужен
+	const std::string& GetStatsPath() const;
+	// Пустой, если трассировка не нужна
+	const std::string& GetTracePath() const;
+	const std::string& GetErrorLogPath() const;
+	// Байты; 0, если бюджет памяти не ограничен
+	size_t GetMaxMemory() const;
+	const std::string& GetPinMode() const;
+	// dir - порядок обхода, lpt - крупные файлы первыми, spt - мелкие первыми
+	const std::string& GetOrder() const;
 
 private:
 	const std::string& GetValueFor(const std::string& argName, size_t& index);
-	void ParseSize(const std::string& sizeStr);
+	void ParseSize(const std::string& sizeArg);
+	void ApplyDefaultLayouts();
+	void ParseStageThreads(const std::string& stagesStr);
+	void ParseInput(const std::string& inputStr);
+	void ParseIncremental(const std::string& modeStr);
 
 	std::vector<std::string> m_args;
 	std::string m_inputDir;
 	std::string m_outputDir;
 	size_t m_numThreads = MIN_THREADS;
-	int m_thumbWidth = 0;
-	int m_thumbHeight = 0;
+	std::vector<SizeOption> m_sizes;
+	std::vector<size_t> m_stageThreads;
+	std::string m_inputMode = "stream";
+	bool m_inputPopulate = false;
+	bool m_inputSequential = false;
+	std::string m_incrementalMode;
+	bool m_dedup = false;
+	bool m_sorted = false;
+	size_t m_scanThreads = MIN_THREADS;
+	bool m_watch = false;
+	bool m_progress = false;
+	std::string m_ioMode = "blocking";
+	size_t m_packCount = 0;
+	size_t m_atlasSize = 0;
+	std::string m_statsPath;
+	std::string m_tracePath;
+	std::string m_errorLogPath;
+	size_t m_maxMemory = 0;
+	std::string m_pinMode = "none";
+	std::string m_order = "dir";
 };
\ No newline at end of file
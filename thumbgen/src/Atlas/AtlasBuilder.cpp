@@ -0,0 +1,218 @@
+#include "AtlasBuilder.h"
+#include "SkylinePacker.h"
+#include "TextUtils.h"
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+// Зазор между спрайтами, чтобы при масштабировании в браузере соседи не
+// просвечивали по краям
+constexpr int SPRITE_PADDING = 1;
+
+std::vector<unsigned char> ToRgba(const std::vector<unsigned char>& pixels, int channels)
+{
+	const size_t pixelCount = pixels.size() / static_cast<size_t>(channels);
+	std::vector<unsigned char> rgba(pixelCount * 4);
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		const unsigned char* src = &pixels[i * static_cast<size_t>(channels)];
+		unsigned char* dst = &rgba[i * 4];
+		const bool isGray = channels < 3;
+		dst[0] = src[0];
+		dst[1] = isGray ? src[0] : src[1];
+		dst[2] = isGray ? src[0] : src[2];
+		dst[3] = channels == 2 ? src[1] : channels == 4 ? src[3] : 255;
+	}
+	return rgba;
+}
+} // namespace
+
+AtlasBuilder::AtlasBuilder(std::string inputDir, std::string outputDir, std::vector<ImageProcessor::OutputSpec> outputs, size_t groupSize)
+	: m_inputDir(std::move(inputDir))
+	, m_outputDir(std::move(outputDir))
+	, m_outputs(std::move(outputs))
+	, m_groupSize(groupSize)
+{
+}
+
+void AtlasBuilder::Assign(const std::string& inputPath)
+{
+	const std::string dir = fs::relative(inputPath, m_inputDir).parent_path().string();
+
+	std::lock_guard lock(m_mutex);
+	const size_t index = m_assignedByDir[dir]++;
+	const GroupKey key{dir, index / m_groupSize};
+	Group& group = m_groups[key];
+	++group.expected;
+	group.isFull = group.expected == m_groupSize;
+	m_assignments[inputPath] = key;
+}
+
+void AtlasBuilder::Add(ImageProcessor::ThumbnailTask& task)
+{
+	std::vector<Sprite> sprites(m_outputs.size());
+	for (auto& rendition : task.renditions)
+	{
+		Sprite& sprite = sprites[rendition.specIndex];
+		sprite.name = fs::path(task.inputPath).filename().string();
+		sprite.width = rendition.size.width;
+		sprite.height = rendition.size.height;
+		sprite.rgba = ToRgba(rendition.pixels, task.channels);
+		rendition.pixels = {};
+	}
+	Receive(task.inputPath, std::move(sprites));
+}
+
+void AtlasBuilder::Skip(const std::string& inputPath)
+{
+	Receive(inputPath, {});
+}
+
+void AtlasBuilder::Receive(const std::string& inputPath, std::vector<Sprite> sprites)
+{
+	std::unique_lock lock(m_mutex);
+	const auto assignment = m_assignments.find(inputPath);
+	if (assignment == m_assignments.end())
+	{
+		return;
+	}
+	const GroupKey key = assignment->second;
+	m_assignments.erase(assignment);
+
+	const auto it = m_groups.find(key);
+	Group& group = it->second;
+	++group.received;
+	if (!sprites.empty())
+	{
+		group.spritesBySpec.resize(m_outputs.size());
+		for (size_t i = 0; i < sprites.size(); ++i)
+		{
+			group.spritesBySpec[i].push_back(std::move(sprites[i]));
+		}
+	}
+	if (!group.isFull || group.received < group.expected)
+	{
+		return;
+	}
+
+	// Атлас собирается вне блокировки, остальные потоки продолжают работу
+	Group completed = std::move(group);
+	m_groups.erase(it);
+	lock.unlock();
+	WriteGroup(key, completed);
+}
+
+void AtlasBuilder::Finish()
+{
+	std::map<GroupKey, Group> groups;
+	{
+		std::lock_guard lock(m_mutex);
+		groups.swap(m_groups);
+		m_assignments.clear();
+	}
+	for (auto& [key, group] : groups)
+	{
+		WriteGroup(key, group);
+	}
+}
+
+size_t AtlasBuilder::GetAtlasCount() const
+{
+	return m_atlasCount;
+}
+
+// Квадрат примерно той же площади, но не уже самого широкого спрайта
+int AtlasBuilder::GetAtlasWidth(const std::vector<Sprite>& sprites)
+{
+	double area = 0;
+	int maxWidth = 0;
+	for (const auto& sprite : sprites)
+	{
+		area += static_cast<double>(sprite.width + SPRITE_PADDING) * (sprite.height + SPRITE_PADDING);
+		maxWidth = std::max(maxWidth, sprite.width + SPRITE_PADDING);
+	}
+	return std::max(maxWidth, static_cast<int>(std::ceil(std::sqrt(area))));
+}
+
+void AtlasBuilder::WriteGroup(const GroupKey& key, Group& group)
+{
+	for (size_t i = 0; i < group.spritesBySpec.size(); ++i)
+	{
+		WriteAtlas(key, i, group.spritesBySpec[i]);
+	}
+}
+
+void AtlasBuilder::WriteAtlas(const GroupKey& key, size_t specIndex, std::vector<Sprite>& sprites)
+{
+	if (sprites.empty())
+	{
+		return;
+	}
+
+	// Высокие спрайты первыми - так линия горизонта получается ровнее;
+	// имя делает раскладку независимой от порядка завершения задач
+	std::ranges::sort(sprites, [](const Sprite& a, const Sprite& b) {
+		return a.height != b.height ? a.height > b.height : a.name < b.name;
+	});
+
+	const int width = GetAtlasWidth(sprites);
+	SkylinePacker packer(width);
+	std::vector<PackedRect> rects;
+	for (const auto& sprite : sprites)
+	{
+		rects.push_back(packer.Insert(sprite.width + SPRITE_PADDING, sprite.height + SPRITE_PADDING));
+	}
+	const int height = packer.GetHeight();
+
+	std::vector<unsigned char> atlas(static_cast<size_t>(width) * height * 4, 0);
+	for (size_t i = 0; i < sprites.size(); ++i)
+	{
+		const Sprite& sprite = sprites[i];
+		const size_t rowSize = static_cast<size_t>(sprite.width) * 4;
+		for (int row = 0; row < sprite.height; ++row)
+		{
+			std::copy_n(
+				&sprite.rgba[static_cast<size_t>(row) * rowSize],
+				rowSize,
+				&atlas[(static_cast<size_t>(rects[i].y + row) * width + rects[i].x) * 4]);
+		}
+	}
+
+	std::string name = "atlas-" + std::to_string(key.second);
+	if (m_outputs.size() > 1)
+	{
+		const auto& maxSize = m_outputs[specIndex].maxSize;
+		name += "-" + std::to_string(maxSize.width) + "x" + std::to_string(maxSize.height);
+	}
+	const fs::path dir = (fs::path(m_outputDir) / key.first).lexically_normal();
+	fs::create_directories(dir);
+
+	const std::string imagePath = (dir / (name + ".png")).string();
+	if (!stbi_write_png(imagePath.c_str(), width, height, 4, atlas.data(), width * 4))
+	{
+		throw std::runtime_error("Не удалось записать атлас: " + imagePath);
+	}
+
+	const std::string mapPath = (dir / (name + ".json")).string();
+	std::ofstream map(mapPath, std::ios::trunc);
+	map << "{\"image\":\"" << EscapeJson(name + ".png") << "\",\"width\":" << width << ",\"height\":" << height << ",\"sprites\":[";
+	for (size_t i = 0; i < sprites.size(); ++i)
+	{
+		map << (i ? "," : "") << "{\"name\":\"" << EscapeJson(sprites[i].name) << "\",\"x\":" << rects[i].x << ",\"y\":" << rects[i].y
+			<< ",\"width\":" << sprites[i].width << ",\"height\":" << sprites[i].height << "}";
+	}
+	map << "]}\n";
+	if (!map)
+	{
+		throw std::runtime_error("Не удалось записать карту атласа: " + mapPath);
+	}
+	++m_atlasCount;
+}
\ No newline at end of file
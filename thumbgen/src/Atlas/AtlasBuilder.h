@@ -0,0 +1,66 @@
+#pragma once
+
+#include "ImageProcessor.h"
+
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// Режим атласов: миниатюры файлов одного каталога собираются по groupSize
+// штук в атласы прямо из буферов масштабирования, без записи и повторного
+// чтения. Атлас - PNG с альфа-каналом, рядом с ним карта координат в JSON.
+// Файлы закрепляются за группой в порядке постановки в очередь; атлас
+// пишется, как только пришли все его миниатюры, неполные группы - в Finish.
+class AtlasBuilder
+{
+public:
+	AtlasBuilder(std::string inputDir, std::string outputDir, std::vector<ImageProcessor::OutputSpec> outputs, size_t groupSize);
+
+	void Assign(const std::string& inputPath);
+	void Add(ImageProcessor::ThumbnailTask& task);
+	// Файл не удалось обработать: группа его больше не ждет
+	void Skip(const std::string& inputPath);
+	void Finish();
+
+	size_t GetAtlasCount() const;
+
+private:
+	using GroupKey = std::pair<std::string, size_t>;
+
+	struct Sprite
+	{
+		std::string name;
+		int width = 0;
+		int height = 0;
+		std::vector<unsigned char> rgba;
+	};
+
+	struct Group
+	{
+		size_t expected = 0;
+		size_t received = 0;
+		bool isFull = false;
+		std::vector<std::vector<Sprite>> spritesBySpec;
+	};
+
+	static int GetAtlasWidth(const std::vector<Sprite>& sprites);
+
+	void Receive(const std::string& inputPath, std::vector<Sprite> sprites);
+	void WriteGroup(const GroupKey& key, Group& group);
+	void WriteAtlas(const GroupKey& key, size_t specIndex, std::vector<Sprite>& sprites);
+
+	std::string m_inputDir;
+	std::string m_outputDir;
+	std::vector<ImageProcessor::OutputSpec> m_outputs;
+	size_t m_groupSize;
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, size_t> m_assignedByDir;
+	std::unordered_map<std::string, GroupKey> m_assignments;
+	std::map<GroupKey, Group> m_groups;
+	std::atomic<size_t> m_atlasCount = 0;
+};
\ No newline at end of file
@@ -0,0 +1,86 @@
+#include "SkylinePacker.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+
+SkylinePacker::SkylinePacker(int width)
+	: m_width(width)
+	, m_skyline{{0, 0, width}}
+{
+}
+
+int SkylinePacker::GetFitY(size_t index, int width) const
+{
+	if (m_skyline[index].x + width > m_width)
+	{
+		return -1;
+	}
+
+	int y = 0;
+	for (int remaining = width; remaining > 0; ++index)
+	{
+		y = std::max(y, m_skyline[index].y);
+		remaining -= m_skyline[index].width;
+	}
+	return y;
+}
+
+PackedRect SkylinePacker::Insert(int width, int height)
+{
+	size_t bestIndex = m_skyline.size();
+	int bestY = std::numeric_limits<int>::max();
+	for (size_t i = 0; i < m_skyline.size(); ++i)
+	{
+		const int y = GetFitY(i, width);
+		if (y >= 0 && y < bestY)
+		{
+			bestIndex = i;
+			bestY = y;
+		}
+	}
+	if (bestIndex == m_skyline.size())
+	{
+		throw std::invalid_argument("Прямоугольник шире полосы атласа");
+	}
+
+	const PackedRect rect{m_skyline[bestIndex].x, bestY};
+	m_height = std::max(m_height, bestY + height);
+
+	// Новый сегмент перекрывает начало линии горизонта под прямоугольником
+	m_skyline.insert(m_skyline.begin() + static_cast<std::ptrdiff_t>(bestIndex), {rect.x, bestY + height, width});
+	const int right = rect.x + width;
+	size_t next = bestIndex + 1;
+	while (next < m_skyline.size() && m_skyline[next].x < right)
+	{
+		Segment& segment = m_skyline[next];
+		const int overlap = right - segment.x;
+		if (overlap < segment.width)
+		{
+			segment.x += overlap;
+			segment.width -= overlap;
+			break;
+		}
+		m_skyline.erase(m_skyline.begin() + static_cast<std::ptrdiff_t>(next));
+	}
+
+	// Соседние сегменты одной высоты сливаются, чтобы линия не дробилась
+	for (size_t i = 0; i + 1 < m_skyline.size();)
+	{
+		if (m_skyline[i].y == m_skyline[i + 1].y)
+		{
+			m_skyline[i].width += m_skyline[i + 1].width;
+			m_skyline.erase(m_skyline.begin() + static_cast<std::ptrdiff_t>(i + 1));
+		}
+		else
+		{
+			++i;
+		}
+	}
+	return rect;
+}
+
+int SkylinePacker::GetHeight() const
+{
+	return m_height;
+}
\ No newline at end of file
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+struct PackedRect
+{
+	int x = 0;
+	int y = 0;
+};
+
+// Упаковка прямоугольников в полосу фиксированной ширины по линии горизонта
+// (skyline bottom-left): каждый ставится туда, где его верх окажется ниже
+// всего. Полоса растет вниз сколько нужно.
+class SkylinePacker
+{
+public:
+	explicit SkylinePacker(int width);
+
+	PackedRect Insert(int width, int height);
+	int GetHeight() const;
+
+private:
+	struct Segment
+	{
+		int x = 0;
+		int y = 0;
+		int width = 0;
+	};
+
+	// Высота, на которую встанет прямоугольник шириной width с начала сегмента
+	int GetFitY(size_t index, int width) const;
+
+	int m_width;
+	int m_height = 0;
+	std::vector<Segment> m_skyline;
+};
\ No newline at end of file
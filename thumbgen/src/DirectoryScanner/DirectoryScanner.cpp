@@ -1,8 +1,10 @@
 #include "DirectoryScanner.h"
+#include "ParallelWalker.h"
 
 #include <algorithm>
 #include <filesystem>
 #include <stdexcept>
+#include <vector>
 
 namespace fs = std::filesystem;
 
@@ -15,13 +17,49 @@ void AssertIsDirecotryValid(const fs::path& dirPath)
 		throw std::runtime_error("Нет такого файла: " + dirPath.string());
 	}
 }
+
+void WalkSorted(const fs::path& dirPath, const std::unordered_set<std::string>& extensions, const DirectoryScanner::FileHandler& onFile)
+{
+	std::vector<fs::directory_entry> entries(fs::directory_iterator(dirPath), fs::directory_iterator{});
+	std::ranges::sort(entries, {}, [](const fs::directory_entry& entry) -> const fs::path& {
+		return entry.path();
+	});
+
+	for (const auto& entry : entries)
+	{
+		if (entry.is_directory() && !entry.is_symlink())
+		{
+			WalkSorted(entry.path(), extensions, onFile);
+		}
+		else if (entry.is_regular_file() && extensions.contains(entry.path().extension().string()))
+		{
+			onFile(entry.path().string());
+		}
+	}
+}
 } // namespace
 
 std::vector<std::string> DirectoryScanner::Scan(const std::string& dirPath, const std::unordered_set<std::string>& extensions)
 {
 	std::vector<std::string> filePaths;
+	Walk(dirPath, extensions, false, [&filePaths](const std::string& filePath) {
+		filePaths.push_back(filePath);
+	});
+
+	std::ranges::sort(filePaths);
+	return filePaths;
+}
+
+void DirectoryScanner::Walk(const std::string& dirPath, const std::unordered_set<std::string>& extensions, bool sorted, const FileHandler& onFile)
+{
 	AssertIsDirecotryValid(dirPath);
 
+	if (sorted)
+	{
+		WalkSorted(dirPath, extensions, onFile);
+		return;
+	}
+
 	for (const auto& file : fs::recursive_directory_iterator(dirPath))
 	{
 		if (file.is_regular_file())
@@ -29,11 +67,16 @@ std::vector<std::string> DirectoryScanner::Scan(const std::string& dirPath, cons
 			std::string extensionFile = file.path().extension().string();
 			if (extensions.contains(extensionFile))
 			{
-				filePaths.emplace_back(file.path().string());
+				onFile(file.path().string());
 			}
 		}
 	}
+}
 
-	std::ranges::sort(filePaths);
-	return filePaths;
+void DirectoryScanner::ParallelWalk(const std::string& dirPath, const std::unordered_set<std::string>& extensions, size_t numThreads, const FileHandler& onFile)
+{
+	AssertIsDirecotryValid(dirPath);
+
+	ParallelWalker walker(extensions, numThreads, onFile);
+	walker.Run(dirPath);
 }
\ No newline at end of file
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <string>
 #include <unordered_set>
 #include <vector>
@@ -6,5 +7,14 @@
 class DirectoryScanner
 {
 public:
+	using FileHandler = std::function<void(const std::string& filePath)>;
+
 	static std::vector<std::string> Scan(const std::string& dirPath, const std::unordered_set<std::string>& fileExtensions);
+	// Передает файлы обработчику по мере обхода, не накапливая список. С sorted
+	// записи каждого каталога перебираются по имени, и порядок файлов от
+	// запуска к запуску один и тот же; памяти нужно не больше одного каталога
+	static void Walk(const std::string& dirPath, const std::unordered_set<std::string>& fileExtensions, bool sorted, const FileHandler& onFile);
+	// Обход в несколько потоков для глубоких деревьев и сетевых ФС. Набор
+	// файлов тот же, порядок не определен; onFile вызывается по одному
+	static void ParallelWalk(const std::string& dirPath, const std::unordered_set<std::string>& fileExtensions, size_t numThreads, const FileHandler& onFile);
 };
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include "ParallelWalker.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <thread>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t DENTS_BUFFER_SIZE = 64 * 1024;
+// Сколько дескрипторов каталогов можно держать открытыми для openat детей;
+// сверх этого дети открываются по полному пути
+constexpr int DIR_FD_BUDGET = 256;
+
+struct LinuxDirent64
+{
+	ino64_t d_ino;
+	off64_t d_off;
+	unsigned short d_reclen;
+	unsigned char d_type;
+	char d_name[];
+};
+
+bool IsDotEntry(const char* name)
+{
+	return name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'));
+}
+
+std::string JoinPath(const std::string& dirPath, const char* name)
+{
+	std::string path = dirPath;
+	if (!path.empty() && path.back() != '/')
+	{
+		path += '/';
+	}
+	return path += name;
+}
+
+// Как и recursive_directory_iterator: в ссылку на каталог не заходим, но
+// ссылка на обычный файл считается файлом
+unsigned char ResolveType(int dirFd, const char* name, unsigned char type)
+{
+	struct stat info{};
+	if (type == DT_UNKNOWN)
+	{
+		if (fstatat(dirFd, name, &info, AT_SYMLINK_NOFOLLOW) != 0)
+		{
+			return DT_UNKNOWN;
+		}
+		if (!S_ISLNK(info.st_mode))
+		{
+			return S_ISDIR(info.st_mode) ? DT_DIR : S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+		}
+	}
+	return fstatat(dirFd, name, &info, 0) == 0 && S_ISREG(info.st_mode) ? DT_REG : DT_UNKNOWN;
+}
+
+// Так же, как fs::path::extension: у "name.ext" - ".ext", у ".hidden" - пусто
+std::string GetExtension(const char* name)
+{
+	const char* dot = std::strrchr(name, '.');
+	return dot && dot != name ? std::string(dot) : std::string();
+}
+} // namespace
+
+struct ParallelWalker::DirFd
+{
+	DirFd(int fd, std::atomic<int>& openFds)
+		: fd(fd)
+		, openFds(openFds)
+	{
+		++openFds;
+	}
+
+	~DirFd()
+	{
+		close(fd);
+		--openFds;
+	}
+
+	DirFd(const DirFd&) = delete;
+	DirFd& operator=(const DirFd&) = delete;
+
+	int fd;
+	std::atomic<int>& openFds;
+};
+
+void ParallelWalker::WorkQueue::Push(DirTask task)
+{
+	std::lock_guard lock(m_mutex);
+	m_tasks.push_back(std::move(task));
+}
+
+bool ParallelWalker::WorkQueue::Pop(DirTask& task)
+{
+	std::lock_guard lock(m_mutex);
+	if (m_tasks.empty())
+	{
+		return false;
+	}
+	task = std::move(m_tasks.back());
+	m_tasks.pop_back();
+	return true;
+}
+
+bool ParallelWalker::WorkQueue::Steal(DirTask& task)
+{
+	std::lock_guard lock(m_mutex);
+	if (m_tasks.empty())
+	{
+		return false;
+	}
+	task = std::move(m_tasks.front());
+	m_tasks.pop_front();
+	return true;
+}
+
+ParallelWalker::ParallelWalker(const std::unordered_set<std::string>& extensions, size_t numThreads, const DirectoryScanner::FileHandler& onFile)
+	: m_extensions(extensions)
+	, m_onFile(onFile)
+	, m_queues(std::max<size_t>(1, numThreads))
+{
+}
+
+void ParallelWalker::Run(const std::string& dirPath)
+{
+	Push(0, {dirPath, nullptr, {}});
+	{
+		std::vector<std::jthread> workers;
+		for (size_t i = 0; i < m_queues.size(); ++i)
+		{
+			workers.emplace_back(&ParallelWalker::RunWorker, this, i);
+		}
+	}
+
+	if (m_error)
+	{
+		std::rethrow_exception(m_error);
+	}
+}
+
+void ParallelWalker::RunWorker(size_t index)
+{
+	std::vector<char> buffer(DENTS_BUFFER_SIZE);
+	DirTask task;
+	while (!m_isStopped)
+	{
+		// Счетчик читается до поиска задачи: Push после неудачного поиска
+		// его уже изменит, и ожидание не уснет
+		const uint32_t wakeups = m_wakeups.load();
+		if (TakeTask(index, task))
+		{
+			try
+			{
+				ProcessDirectory(index, task, buffer);
+			}
+			catch (...)
+			{
+				Fail(std::current_exception());
+			}
+			task = {};
+			if (--m_pendingTasks == 0)
+			{
+				Wake();
+			}
+		}
+		else if (m_pendingTasks == 0)
+		{
+			return;
+		}
+		else
+		{
+			// Обход может надолго встать в EmitFile, пока пул разбирает
+			// очередь: свободные потоки ждут, не занимая ядра
+			m_wakeups.wait(wakeups);
+		}
+	}
+}
+
+bool ParallelWalker::TakeTask(size_t index, DirTask& task)
+{
+	if (m_queues[index].Pop(task))
+	{
+		return true;
+	}
+	for (size_t i = 1; i < m_queues.size(); ++i)
+	{
+		if (m_queues[(index + i) % m_queues.size()].Steal(task))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void ParallelWalker::Push(size_t index, DirTask task)
+{
+	++m_pendingTasks;
+	m_queues[index].Push(std::move(task));
+	Wake();
+}
+
+void ParallelWalker::Wake()
+{
+	++m_wakeups;
+	m_wakeups.notify_all();
+}
+
+int ParallelWalker::OpenDirectory(const DirTask& task) const
+{
+	const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC;
+	const int fd = task.parent
+		? openat(task.parent->fd, task.name.c_str(), flags | O_NOFOLLOW)
+		: open(task.path.c_str(), flags);
+	if (fd < 0)
+	{
+		throw std::runtime_error("Не удалось открыть каталог: " + task.path);
+	}
+	return fd;
+}
+
+void ParallelWalker::ProcessDirectory(size_t index, DirTask& task, std::vector<char>& buffer)
+{
+	const auto dir = std::make_shared<DirFd>(OpenDirectory(task), m_openFds);
+	task.parent.reset();
+
+	while (true)
+	{
+		const long size = syscall(SYS_getdents64, dir->fd, buffer.data(), buffer.size());
+		if (size < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (size < 0)
+		{
+			throw std::runtime_error("Ошибка чтения каталога: " + task.path);
+		}
+		if (size == 0)
+		{
+			return;
+		}
+
+		for (long offset = 0; offset < size;)
+		{
+			const auto* entry = reinterpret_cast<const LinuxDirent64*>(buffer.data() + offset);
+			offset += entry->d_reclen;
+			if (IsDotEntry(entry->d_name))
+			{
+				continue;
+			}
+
+			unsigned char type = entry->d_type;
+			if (type == DT_UNKNOWN || type == DT_LNK)
+			{
+				type = ResolveType(dir->fd, entry->d_name, type);
+			}
+
+			if (type == DT_DIR)
+			{
+				const bool canShareFd = m_openFds.load() < DIR_FD_BUDGET;
+				Push(index, {JoinPath(task.path, entry->d_name), canShareFd ? dir : nullptr, entry->d_name});
+			}
+			else if (type == DT_REG && IsWanted(entry->d_name))
+			{
+				EmitFile(JoinPath(task.path, entry->d_name));
+			}
+		}
+	}
+}
+
+bool ParallelWalker::IsWanted(const char* name) const
+{
+	return m_extensions.contains(GetExtension(name));
+}
+
+// Обработчик файлов вызывается из одного потока за раз
+void ParallelWalker::EmitFile(std::string filePath)
+{
+	std::lock_guard lock(m_emitMutex);
+	if (!m_isStopped)
+	{
+		m_onFile(filePath);
+	}
+}
+
+void ParallelWalker::Fail(std::exception_ptr error)
+{
+	std::lock_guard lock(m_errorMutex);
+	if (!m_error)
+	{
+		m_error = std::move(error);
+	}
+	m_isStopped = true;
+	Wake();
+}
\ No newline at end of file
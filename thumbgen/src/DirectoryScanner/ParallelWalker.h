@@ -0,0 +1,72 @@
+#pragma once
+
+#include "DirectoryScanner.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+// Параллельный обход дерева: каждый подкаталог - задача в очереди потока.
+// Поток берет свои задачи с конца (в глубину), а свободный поток крадет
+// чужие с начала, где лежат самые крупные поддеревья. Каталоги читаются
+// через getdents64 и открываются openat относительно родителя; тип записи
+// берется из d_type, так что stat нужен только для ссылок и ФС без d_type.
+class ParallelWalker
+{
+public:
+	ParallelWalker(const std::unordered_set<std::string>& extensions, size_t numThreads, const DirectoryScanner::FileHandler& onFile);
+
+	void Run(const std::string& dirPath);
+
+private:
+	struct DirFd;
+
+	struct DirTask
+	{
+		std::string path;
+		std::shared_ptr<DirFd> parent;
+		std::string name;
+	};
+
+	class WorkQueue
+	{
+	public:
+		void Push(DirTask task);
+		bool Pop(DirTask& task);
+		bool Steal(DirTask& task);
+
+	private:
+		std::mutex m_mutex;
+		std::deque<DirTask> m_tasks;
+	};
+
+	void RunWorker(size_t index);
+	bool TakeTask(size_t index, DirTask& task);
+	void ProcessDirectory(size_t index, DirTask& task, std::vector<char>& buffer);
+	int OpenDirectory(const DirTask& task) const;
+	void Push(size_t index, DirTask task);
+	void Wake();
+	void EmitFile(std::string filePath);
+	bool IsWanted(const char* name) const;
+	void Fail(std::exception_ptr error);
+
+	const std::unordered_set<std::string>& m_extensions;
+	const DirectoryScanner::FileHandler& m_onFile;
+	std::vector<WorkQueue> m_queues;
+	std::atomic<size_t> m_pendingTasks = 0;
+	// Меняется при каждой новой задаче и при конце обхода: по нему ждут
+	// свободные потоки
+	std::atomic<uint32_t> m_wakeups = 0;
+	std::atomic<int> m_openFds = 0;
+	std::atomic<bool> m_isStopped = false;
+	std::mutex m_emitMutex;
+	std::mutex m_errorMutex;
+	std::exception_ptr m_error;
+};
\ No newline at end of file
@@ -0,0 +1,84 @@
+#include "DirectoryScanner.h"
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Сравнение обхода через recursive_directory_iterator с параллельным обходом
+// на getdents64: медиана времени по нескольким повторам и проверка, что набор
+// файлов совпадает. Запуск: scan-benchmark DIR [MAX_THREADS] [REPEATS]
+namespace
+{
+const std::unordered_set<std::string> IMG_EXTENSIONS = {".png", ".jpg", ".jpeg"};
+constexpr size_t DEFAULT_MAX_THREADS = 8;
+constexpr size_t DEFAULT_REPEATS = 5;
+
+struct Measurement
+{
+	double medianMs = 0;
+	std::vector<std::string> files;
+};
+
+Measurement Measure(size_t repeats, const std::function<void(const DirectoryScanner::FileHandler&)>& walk)
+{
+	Measurement result;
+	std::vector<double> times;
+	for (size_t i = 0; i < repeats; ++i)
+	{
+		std::vector<std::string> files;
+		const auto start = std::chrono::steady_clock::now();
+		walk([&files](const std::string& filePath) {
+			files.push_back(filePath);
+		});
+		const auto end = std::chrono::steady_clock::now();
+		times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+		result.files = std::move(files);
+	}
+
+	std::ranges::sort(times);
+	std::ranges::sort(result.files);
+	result.medianMs = times[times.size() / 2];
+	return result;
+}
+} // namespace
+
+int main(int argc, char* argv[])
+{
+	if (argc < 2)
+	{
+		std::cerr << "Ожидается: scan-benchmark DIR [MAX_THREADS] [REPEATS]" << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	try
+	{
+		const std::string dirPath = argv[1];
+		const size_t maxThreads = argc > 2 ? std::stoul(argv[2]) : DEFAULT_MAX_THREADS;
+		const size_t repeats = std::max<size_t>(1, argc > 3 ? std::stoul(argv[3]) : DEFAULT_REPEATS);
+
+		const Measurement baseline = Measure(repeats, [&](const DirectoryScanner::FileHandler& onFile) {
+			DirectoryScanner::Walk(dirPath, IMG_EXTENSIONS, false, onFile);
+		});
+		std::cout << "recursive_directory_iterator: " << baseline.medianMs << " мс, файлов " << baseline.files.size() << std::endl;
+
+		for (size_t threads = 1; threads <= maxThreads; threads *= 2)
+		{
+			const Measurement parallel = Measure(repeats, [&](const DirectoryScanner::FileHandler& onFile) {
+				DirectoryScanner::ParallelWalk(dirPath, IMG_EXTENSIONS, threads, onFile);
+			});
+			std::cout << "getdents64, потоков " << threads << ": " << parallel.medianMs << " мс"
+					  << " (x" << baseline.medianMs / parallel.medianMs << "), файлов " << parallel.files.size()
+					  << (parallel.files == baseline.files ? "" : ", НАБОР ФАЙЛОВ ОТЛИЧАЕТСЯ") << std::endl;
+		}
+	}
+	catch (const std::exception& e)
+	{
+		std::cerr << "Error: " << e.what() << std::endl;
+		return EXIT_FAILURE;
+	}
+
+	return EXIT_SUCCESS;
+}
\ No newline at end of file
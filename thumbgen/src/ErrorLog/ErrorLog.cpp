@@ -0,0 +1,197 @@
+#include "ErrorLog.h"
+#include "Image.h"
+#include "Progress.h"
+#include "StageStats.h"
+#include "TextUtils.h"
+
+#include <iomanip>
+#include <stdexcept>
+
+namespace
+{
+// Записей в кольце потока: столько ошибок подряд поток отдает, не дожидаясь
+// потока записи
+constexpr size_t RING_CAPACITY = 256;
+
+struct ThreadRing
+{
+	const void* owner = nullptr;
+	void* ring = nullptr;
+};
+
+thread_local ThreadRing t_ring;
+} // namespace
+
+ErrorLog::Ring::Ring(size_t threadIndex)
+	: entries(RING_CAPACITY)
+	, threadIndex(threadIndex)
+{
+}
+
+ErrorLog::ErrorLog(const std::string& filePath)
+	: m_startTime(std::chrono::steady_clock::now())
+{
+	if (!filePath.empty())
+	{
+		m_file.open(filePath, std::ios::trunc);
+		if (!m_file)
+		{
+			throw std::runtime_error("Не удалось открыть журнал ошибок: " + filePath);
+		}
+		m_file << std::fixed << std::setprecision(3);
+	}
+	m_writer = std::thread([this] {
+		Run();
+	});
+}
+
+ErrorLog::~ErrorLog()
+{
+	Close();
+}
+
+void ErrorLog::Report(const std::string& filePath, const std::exception& error)
+{
+	Entry entry;
+	entry.filePath = filePath;
+	entry.message = error.what();
+	if (const auto failure = StageStats::TakeFailure(filePath))
+	{
+		entry.stage = StageStats::GetStageName(failure->stage);
+		entry.elapsedMs = failure->elapsedMs;
+	}
+	if (const auto* decodeError = dynamic_cast<const DecodeError*>(&error))
+	{
+		entry.reason = decodeError->GetReason();
+	}
+	entry.timeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - m_startTime).count();
+
+	Ring& ring = GetThreadRing();
+	const size_t head = ring.head.load(std::memory_order_relaxed);
+	while (head - ring.tail.load(std::memory_order_acquire) == ring.entries.size())
+	{
+		Wake();
+		std::this_thread::yield();
+	}
+	ring.entries[head % ring.entries.size()] = std::move(entry);
+	ring.head.store(head + 1, std::memory_order_release);
+	Wake();
+}
+
+void ErrorLog::Close()
+{
+	if (!m_writer.joinable())
+	{
+		return;
+	}
+	m_isStopping = true;
+	Wake();
+	m_writer.join();
+}
+
+ErrorLog::Ring& ErrorLog::GetThreadRing()
+{
+	if (t_ring.owner != this)
+	{
+		std::lock_guard lock(m_ringsMutex);
+		m_rings.push_back(std::make_unique<Ring>(m_rings.size()));
+		t_ring = {this, m_rings.back().get()};
+	}
+	return *static_cast<Ring*>(t_ring.ring);
+}
+
+void ErrorLog::Wake()
+{
+	if (!m_hasPending.exchange(true))
+	{
+		m_hasPending.notify_one();
+	}
+}
+
+void ErrorLog::Run()
+{
+	while (true)
+	{
+		m_hasPending.wait(false);
+		m_hasPending = false;
+		// Остановка приходит после последней записи, поэтому проход после
+		// нее забирает все
+		const bool isStopping = m_isStopping;
+		Drain();
+		if (isStopping)
+		{
+			return;
+		}
+	}
+}
+
+void ErrorLog::Drain()
+{
+	// Кольца живут до конца журнала, даже если их поток завершился
+	std::vector<Ring*> rings;
+	{
+		std::lock_guard lock(m_ringsMutex);
+		for (const auto& ring : m_rings)
+		{
+			rings.push_back(ring.get());
+		}
+	}
+
+	for (Ring* ring : rings)
+	{
+		const size_t head = ring->head.load(std::memory_order_acquire);
+		for (size_t tail = ring->tail.load(std::memory_order_relaxed); tail != head; ++tail)
+		{
+			const Entry entry = std::move(ring->entries[tail % ring->entries.size()]);
+			ring->tail.store(tail + 1, std::memory_order_release);
+			Write(entry, ring->threadIndex);
+		}
+	}
+	if (m_file.is_open())
+	{
+		m_file.flush();
+	}
+}
+
+void ErrorLog::Write(const Entry& entry, size_t threadIndex)
+{
+	// Строка собирается целиком и уходит одной записью, не разрывая строку хода
+	Progress::PrintMessage("Ошибка при обработке файла " + entry.filePath + ": " + entry.message + "\n");
+
+	if (!m_file.is_open())
+	{
+		return;
+	}
+	m_file << "{\"time_ms\":" << entry.timeMs
+		   << ",\"thread\":" << threadIndex
+		   << ",\"file\":\"" << EscapeJson(entry.filePath) << "\"";
+	m_file << ",\"stage\":";
+	if (entry.stage)
+	{
+		m_file << "\"" << entry.stage << "\"";
+	}
+	else
+	{
+		m_file << "null";
+	}
+	m_file << ",\"error\":\"" << EscapeJson(entry.message) << "\"";
+	m_file << ",\"reason\":";
+	if (entry.reason)
+	{
+		m_file << "\"" << EscapeJson(entry.reason) << "\"";
+	}
+	else
+	{
+		m_file << "null";
+	}
+	m_file << ",\"elapsed_ms\":";
+	if (entry.elapsedMs >= 0)
+	{
+		m_file << entry.elapsedMs;
+	}
+	else
+	{
+		m_file << "null";
+	}
+	m_file << "}\n";
+}
\ No newline at end of file
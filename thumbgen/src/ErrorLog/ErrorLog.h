@@ -0,0 +1,72 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Журнал ошибок обработки файлов. Рабочий поток кладет запись в свое кольцо
+// без блокировок и сразу возвращается к работе, а отдельный поток пишет
+// записи в stderr и, если задан файл, построчным JSON (NDJSON) со стадией,
+// причиной от stb_image и временем обработки до ошибки.
+// Переполненное кольцо задерживает свой поток, а не теряет запись
+class ErrorLog
+{
+public:
+	// Пустой filePath - только stderr
+	explicit ErrorLog(const std::string& filePath);
+	~ErrorLog();
+
+	ErrorLog(const ErrorLog&) = delete;
+	ErrorLog& operator=(const ErrorLog&) = delete;
+
+	// Стадия берется из отметки StageStats, поставленной в этом же потоке
+	void Report(const std::string& filePath, const std::exception& error);
+	// Дописывает все отправленные записи и останавливает поток записи.
+	// Вызывается, когда рабочие потоки уже остановлены
+	void Close();
+
+private:
+	struct Entry
+	{
+		std::string filePath;
+		std::string message;
+		const char* stage = nullptr;
+		const char* reason = nullptr;
+		double elapsedMs = -1;
+		double timeMs = 0;
+	};
+
+	// Один писатель - поток-владелец, один читатель - поток записи
+	struct Ring
+	{
+		explicit Ring(size_t threadIndex);
+
+		std::vector<Entry> entries;
+		std::atomic<size_t> head = 0;
+		std::atomic<size_t> tail = 0;
+		size_t threadIndex;
+	};
+
+	Ring& GetThreadRing();
+	void Wake();
+	void Run();
+	void Drain();
+	void Write(const Entry& entry, size_t threadIndex);
+
+	std::ofstream m_file;
+	std::chrono::steady_clock::time_point m_startTime;
+
+	std::mutex m_ringsMutex;
+	std::vector<std::unique_ptr<Ring>> m_rings;
+
+	std::atomic<bool> m_hasPending = false;
+	std::atomic<bool> m_isStopping = false;
+	std::thread m_writer;
+};
\ No newline at end of file
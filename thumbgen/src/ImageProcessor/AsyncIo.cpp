@@ -0,0 +1,603 @@
+#include "AsyncIo.h"
+#include "BufferArena.h"
+#include "StageStats.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <stdexcept>
+#include <utility>
+#include <sys/eventfd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr unsigned RING_ENTRIES = 256;
+// Каждая операция держит в кольце не больше двух SQE
+constexpr size_t MAX_IN_FLIGHT = RING_ENTRIES / 2 - 1;
+// Большинство исходников-фотографий укладывается в зарегистрированный буфер
+constexpr size_t FIXED_BUFFER_SIZE = 4 * 1024 * 1024;
+constexpr size_t MAX_FIXED_BUFFERS = 32;
+// Ядро передает за раз не больше, чем помещается в len
+constexpr size_t MAX_TRANSFER_SIZE = 1u << 30;
+
+// В младших битах user_data хранится шаг операции
+constexpr uint64_t STEP_MASK = 3;
+constexpr uint64_t IGNORED_USER_DATA = 0;
+constexpr uint64_t WAKEUP_USER_DATA = ~uint64_t{0};
+
+enum Step
+{
+	STEP_OPEN,
+	STEP_STAT,
+	STEP_TRANSFER,
+	STEP_CLOSE,
+};
+
+enum class OperationKind
+{
+	Read,
+	Write,
+};
+
+std::exception_ptr MakeError(const std::string& message)
+{
+	return std::make_exception_ptr(std::runtime_error(message));
+}
+} // namespace
+
+struct AsyncIo::WriteGroup
+{
+	size_t remaining = 0;
+	std::exception_ptr error;
+	WriteHandler onWritten;
+};
+
+struct AsyncIo::Operation
+{
+	OperationKind kind = OperationKind::Read;
+	std::string filePath;
+	int fd = -1;
+	int pending = 0;
+	std::exception_ptr error;
+	struct statx stat{};
+	size_t size = 0;
+	size_t offset = 0;
+
+	unsigned char* buffer = nullptr;
+	int fixedIndex = -1;
+	ReadHandler onRead;
+	StageStats::Clock::time_point startTime;
+
+	const unsigned char* data = nullptr;
+	std::shared_ptr<WriteGroup> group;
+};
+
+// Буферы, зарегистрированные в кольце: чтение в них обходится без
+// отображения страниц на каждый запрос. Освобождаются из рабочих потоков
+// вместе с SourceFile, поэтому защищены мьютексом
+struct AsyncIo::FixedBuffers
+{
+	std::mutex mutex;
+	std::vector<void*> buffers;
+	std::vector<int> freeIndices;
+
+	~FixedBuffers()
+	{
+		for (void* buffer : buffers)
+		{
+			BufferArena::Free(buffer);
+		}
+	}
+
+	int Take()
+	{
+		std::lock_guard lock(mutex);
+		if (freeIndices.empty())
+		{
+			return -1;
+		}
+		const int index = freeIndices.back();
+		freeIndices.pop_back();
+		return index;
+	}
+
+	void Put(int index)
+	{
+		std::lock_guard lock(mutex);
+		freeIndices.push_back(index);
+	}
+};
+
+AsyncIo::AsyncIo(size_t maxInFlight)
+	: m_ring(RING_ENTRIES)
+	, m_fixedBuffers(std::make_shared<FixedBuffers>())
+	, m_maxInFlight(std::clamp<size_t>(maxInFlight, 1, MAX_IN_FLIGHT))
+	, m_wakeupFd(eventfd(0, EFD_CLOEXEC))
+{
+	if (m_wakeupFd < 0)
+	{
+		throw std::runtime_error("Не удалось создать eventfd для io_uring");
+	}
+
+	std::vector<iovec> iovecs;
+	for (size_t i = 0; i < std::min(m_maxInFlight, MAX_FIXED_BUFFERS); ++i)
+	{
+		void* buffer = BufferArena::Allocate(FIXED_BUFFER_SIZE);
+		if (!buffer)
+		{
+			break;
+		}
+		m_fixedBuffers->buffers.push_back(buffer);
+		iovecs.push_back({buffer, FIXED_BUFFER_SIZE});
+	}
+	// Регистрация упирается в RLIMIT_MEMLOCK: пробуем зарегистрировать меньше
+	// буферов, а без нее читаем обычным READ. Незарегистрированные блоки
+	// сразу возвращаются арене, чтобы ими пользовалось декодирование
+	size_t registeredCount = iovecs.size();
+	while (registeredCount > 0 && !m_ring.RegisterBuffers(iovecs.data(), static_cast<unsigned>(registeredCount)))
+	{
+		registeredCount /= 2;
+	}
+	auto& buffers = m_fixedBuffers->buffers;
+	for (size_t i = registeredCount; i < buffers.size(); ++i)
+	{
+		BufferArena::Free(buffers[i]);
+	}
+	buffers.resize(registeredCount);
+	for (size_t i = 0; i < registeredCount; ++i)
+	{
+		m_fixedBuffers->freeIndices.push_back(static_cast<int>(i));
+	}
+
+	m_thread = std::thread([this] {
+		Run();
+	});
+}
+
+AsyncIo::~AsyncIo()
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_isStopping = true;
+	}
+	const uint64_t one = 1;
+	(void)write(m_wakeupFd, &one, sizeof(one));
+	m_thread.join();
+	close(m_wakeupFd);
+}
+
+void AsyncIo::Read(const std::string& filePath, ReadHandler onRead)
+{
+	auto operation = std::make_unique<Operation>();
+	operation->kind = OperationKind::Read;
+	operation->filePath = filePath;
+	operation->onRead = std::move(onRead);
+
+	std::vector<std::unique_ptr<Operation>> operations;
+	operations.push_back(std::move(operation));
+	Post(std::move(operations));
+}
+
+void AsyncIo::Write(std::vector<WriteRequest> requests, WriteHandler onWritten)
+{
+	if (requests.empty())
+	{
+		onWritten(nullptr);
+		return;
+	}
+
+	auto group = std::make_shared<WriteGroup>();
+	group->remaining = requests.size();
+	group->onWritten = std::move(onWritten);
+
+	std::vector<std::unique_ptr<Operation>> operations;
+	for (auto& request : requests)
+	{
+		auto operation = std::make_unique<Operation>();
+		operation->kind = OperationKind::Write;
+		operation->filePath = std::move(request.filePath);
+		operation->data = request.data;
+		operation->size = request.size;
+		operation->group = group;
+		operations.push_back(std::move(operation));
+	}
+	Post(std::move(operations));
+}
+
+void AsyncIo::Post(std::vector<std::unique_ptr<Operation>> operations)
+{
+	std::exception_ptr error;
+	{
+		std::lock_guard lock(m_mutex);
+		error = m_error;
+		if (!error)
+		{
+			for (auto& operation : operations)
+			{
+				m_queue.push_back(std::move(operation));
+			}
+		}
+	}
+	// Поток ввода-вывода уже остановлен ошибкой: запросы ему не отдаются
+	if (error)
+	{
+		for (const auto& operation : operations)
+		{
+			Complete(*operation, error);
+		}
+		return;
+	}
+	const uint64_t one = 1;
+	(void)write(m_wakeupFd, &one, sizeof(one));
+}
+
+void AsyncIo::Run()
+{
+	try
+	{
+		ArmWakeup();
+		while (true)
+		{
+			m_ring.Submit(1);
+
+			bool isWoken = false;
+			while (const io_uring_cqe* cqe = m_ring.PeekCqe())
+			{
+				const uint64_t userData = cqe->user_data;
+				const int result = cqe->res;
+				m_ring.PopCqe();
+
+				if (userData == WAKEUP_USER_DATA)
+				{
+					isWoken = true;
+				}
+				else if (userData != IGNORED_USER_DATA)
+				{
+					HandleCompletion(reinterpret_cast<Operation*>(userData & ~STEP_MASK), static_cast<int>(userData & STEP_MASK), result);
+				}
+			}
+			if (isWoken)
+			{
+				ArmWakeup();
+			}
+
+			StartQueued();
+			std::lock_guard lock(m_mutex);
+			if (m_isStopping && m_queue.empty() && m_inFlight == 0)
+			{
+				return;
+			}
+		}
+	}
+	catch (const std::exception&)
+	{
+		Fail(std::current_exception());
+	}
+}
+
+// Ошибка кольца или обработчика: вместо std::terminate каждый запрос
+// получает ошибку через свой обработчик, и вызывающие доводят учет до конца
+void AsyncIo::Fail(std::exception_ptr error)
+{
+	std::deque<std::unique_ptr<Operation>> queued;
+	{
+		std::lock_guard lock(m_mutex);
+		m_error = error;
+		queued.swap(m_queue);
+	}
+
+	// Ядро может еще обращаться к буферу, пути и statx начатой операции,
+	// поэтому они не освобождаются
+	for (Operation* operation : std::exchange(m_started, {}))
+	{
+		operation->buffer = nullptr;
+		operation->fixedIndex = -1;
+		try
+		{
+			Complete(*operation, error);
+		}
+		catch (const std::exception&)
+		{
+			// Обработчик уже получил ошибку; сообщить о второй некуда
+		}
+	}
+	for (const auto& operation : queued)
+	{
+		try
+		{
+			Complete(*operation, error);
+		}
+		catch (const std::exception&)
+		{
+		}
+	}
+}
+
+// Новые запросы будят поток через eventfd, чтение которого стоит в том же
+// кольце, что и файловые операции
+void AsyncIo::ArmWakeup()
+{
+	io_uring_sqe* sqe = GetSqe();
+	sqe->opcode = IORING_OP_READ;
+	sqe->fd = m_wakeupFd;
+	sqe->addr = reinterpret_cast<uint64_t>(&m_wakeupValue);
+	sqe->len = sizeof(m_wakeupValue);
+	sqe->user_data = WAKEUP_USER_DATA;
+}
+
+void AsyncIo::StartQueued()
+{
+	while (m_inFlight < m_maxInFlight)
+	{
+		std::unique_ptr<Operation> operation;
+		{
+			std::lock_guard lock(m_mutex);
+			if (m_queue.empty())
+			{
+				return;
+			}
+			// Операция учитывается начатой, пока еще лежит в очереди: так при
+			// ошибке она окажется хотя бы в одном из списков
+			m_started.insert(m_queue.front().get());
+			operation = std::move(m_queue.front());
+			m_queue.pop_front();
+		}
+		++m_inFlight;
+		Start(operation.release());
+	}
+}
+
+void AsyncIo::Start(Operation* operation)
+{
+	const uint64_t userData = reinterpret_cast<uint64_t>(operation);
+	if (operation->kind == OperationKind::Read && StageStats::IsEnabled())
+	{
+		operation->startTime = StageStats::Clock::now();
+	}
+
+	if (operation->kind == OperationKind::Write)
+	{
+		io_uring_sqe* sqe = GetSqe();
+		sqe->opcode = IORING_OP_OPENAT;
+		sqe->fd = AT_FDCWD;
+		sqe->addr = reinterpret_cast<uint64_t>(operation->filePath.c_str());
+		sqe->open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+		sqe->len = 0644;
+		sqe->user_data = userData | STEP_OPEN;
+		operation->pending = 1;
+		return;
+	}
+
+	// Открытие и размер файла запрашиваются одновременно
+	io_uring_sqe* sqe = GetSqe();
+	sqe->opcode = IORING_OP_OPENAT;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = reinterpret_cast<uint64_t>(operation->filePath.c_str());
+	sqe->open_flags = O_RDONLY | O_CLOEXEC;
+	sqe->user_data = userData | STEP_OPEN;
+
+	sqe = GetSqe();
+	sqe->opcode = IORING_OP_STATX;
+	sqe->fd = AT_FDCWD;
+	sqe->addr = reinterpret_cast<uint64_t>(operation->filePath.c_str());
+	sqe->len = STATX_SIZE;
+	sqe->off = reinterpret_cast<uint64_t>(&operation->stat);
+	sqe->user_data = userData | STEP_STAT;
+	operation->pending = 2;
+}
+
+void AsyncIo::HandleCompletion(Operation* operation, int step, int result)
+{
+	const bool isRead = operation->kind == OperationKind::Read;
+	switch (step)
+	{
+	case STEP_OPEN:
+		if (result >= 0)
+		{
+			operation->fd = result;
+		}
+		else if (!operation->error)
+		{
+			operation->error = MakeError((isRead ? "Не удалось открыть файл: " : "Не удалось открыть файл для записи: ") + operation->filePath);
+		}
+		break;
+	case STEP_STAT:
+		if (result < 0 && !operation->error)
+		{
+			operation->error = MakeError("Не удалось получить размер файла: " + operation->filePath);
+		}
+		break;
+	case STEP_TRANSFER:
+		// Файл укоротился после statx: читаем то, что есть
+		if (isRead && result == 0)
+		{
+			operation->size = operation->offset;
+		}
+		else if (result <= 0)
+		{
+			operation->error = MakeError((isRead ? "Ошибка чтения файла: " : "Ошибка записи файла: ") + operation->filePath);
+		}
+		else
+		{
+			operation->offset += static_cast<size_t>(result);
+		}
+		break;
+	case STEP_CLOSE:
+		if (result < 0)
+		{
+			operation->error = MakeError("Ошибка записи файла: " + operation->filePath);
+		}
+		Finish(operation, operation->error);
+		return;
+	}
+
+	if (--operation->pending > 0)
+	{
+		return;
+	}
+	if (isRead)
+	{
+		ContinueRead(operation);
+	}
+	else
+	{
+		ContinueWrite(operation);
+	}
+}
+
+void AsyncIo::ContinueRead(Operation* operation)
+{
+	if (operation->error)
+	{
+		CloseFile(operation->fd);
+		Finish(operation, operation->error);
+		return;
+	}
+
+	if (!operation->buffer && operation->offset == 0)
+	{
+		operation->size = static_cast<size_t>(operation->stat.stx_size);
+		if (operation->size > 0)
+		{
+			operation->fixedIndex = operation->size <= FIXED_BUFFER_SIZE ? m_fixedBuffers->Take() : -1;
+			operation->buffer = static_cast<unsigned char*>(operation->fixedIndex >= 0
+					? m_fixedBuffers->buffers[static_cast<size_t>(operation->fixedIndex)]
+					: BufferArena::Allocate(operation->size));
+			if (!operation->buffer)
+			{
+				CloseFile(operation->fd);
+				Finish(operation, std::make_exception_ptr(std::bad_alloc()));
+				return;
+			}
+		}
+	}
+
+	if (operation->offset < operation->size)
+	{
+		io_uring_sqe* sqe = GetSqe();
+		sqe->opcode = operation->fixedIndex >= 0 ? IORING_OP_READ_FIXED : IORING_OP_READ;
+		sqe->fd = operation->fd;
+		sqe->addr = reinterpret_cast<uint64_t>(operation->buffer + operation->offset);
+		sqe->len = static_cast<unsigned>(std::min(operation->size - operation->offset, MAX_TRANSFER_SIZE));
+		sqe->off = operation->offset;
+		sqe->buf_index = static_cast<uint16_t>(std::max(operation->fixedIndex, 0));
+		sqe->user_data = reinterpret_cast<uint64_t>(operation) | STEP_TRANSFER;
+		operation->pending = 1;
+		return;
+	}
+
+	CloseFile(operation->fd);
+	Finish(operation, nullptr);
+}
+
+void AsyncIo::ContinueWrite(Operation* operation)
+{
+	if (operation->error)
+	{
+		CloseFile(operation->fd);
+		Finish(operation, operation->error);
+		return;
+	}
+
+	io_uring_sqe* sqe = GetSqe();
+	if (operation->offset < operation->size)
+	{
+		sqe->opcode = IORING_OP_WRITE;
+		sqe->fd = operation->fd;
+		sqe->addr = reinterpret_cast<uint64_t>(operation->data + operation->offset);
+		sqe->len = static_cast<unsigned>(std::min(operation->size - operation->offset, MAX_TRANSFER_SIZE));
+		sqe->off = operation->offset;
+		sqe->user_data = reinterpret_cast<uint64_t>(operation) | STEP_TRANSFER;
+		operation->pending = 1;
+		return;
+	}
+
+	// Ошибка отложенной записи может всплыть только при закрытии
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = operation->fd;
+	sqe->user_data = reinterpret_cast<uint64_t>(operation) | STEP_CLOSE;
+	operation->fd = -1;
+}
+
+void AsyncIo::Finish(Operation* operation, std::exception_ptr error)
+{
+	std::unique_ptr<Operation> owner(operation);
+	--m_inFlight;
+	m_started.erase(operation);
+	Complete(*operation, error);
+}
+
+void AsyncIo::Complete(Operation& operation, std::exception_ptr error)
+{
+	if (operation.kind == OperationKind::Write)
+	{
+		WriteGroup& group = *operation.group;
+		if (error && !group.error)
+		{
+			group.error = error;
+		}
+		if (--group.remaining == 0)
+		{
+			group.onWritten(group.error);
+		}
+		return;
+	}
+
+	std::function<void()> release;
+	if (operation.fixedIndex >= 0)
+	{
+		release = [buffers = m_fixedBuffers, index = operation.fixedIndex] {
+			buffers->Put(index);
+		};
+	}
+	else if (operation.buffer)
+	{
+		release = [buffer = operation.buffer] {
+			BufferArena::Free(buffer);
+		};
+	}
+
+	if (error)
+	{
+		if (release)
+		{
+			release();
+		}
+		operation.onRead(nullptr, error);
+		return;
+	}
+	if (StageStats::IsEnabled())
+	{
+		StageStats::Record(StageStats::Stage::Read, operation.filePath, operation.startTime);
+		StageStats::AddSource(operation.filePath, operation.size);
+	}
+	operation.onRead(std::make_unique<SourceFile>(operation.buffer, operation.size, std::move(release)), nullptr);
+}
+
+void AsyncIo::CloseFile(int fd)
+{
+	if (fd < 0)
+	{
+		return;
+	}
+	io_uring_sqe* sqe = GetSqe();
+	sqe->opcode = IORING_OP_CLOSE;
+	sqe->fd = fd;
+	sqe->user_data = IGNORED_USER_DATA;
+}
+
+io_uring_sqe* AsyncIo::GetSqe()
+{
+	io_uring_sqe* sqe = m_ring.GetSqe();
+	if (!sqe)
+	{
+		m_ring.Submit(0);
+		sqe = m_ring.GetSqe();
+	}
+	if (!sqe)
+	{
+		throw std::runtime_error("Очередь отправки io_uring переполнена");
+	}
+	return sqe;
+}
\ No newline at end of file
@@ -0,0 +1,82 @@
+#pragma once
+
+#include "IoRing.h"
+#include "SourceFile.h"
+
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+// Чтение исходников и запись миниатюр через io_uring в отдельном потоке.
+// Поток пачками отправляет открытие, чтение и закрытие файлов сразу для
+// многих запросов, поэтому рабочие потоки не простаивают на диске.
+// Небольшие исходники читаются в зарегистрированные в кольце буферы арены,
+// остальные - в обычные блоки арены. Обработчики вызываются из потока
+// ввода-вывода и должны быть короткими. Если поток ввода-вывода сам падает,
+// все начатые и ожидающие запросы, как и последующие, завершаются с его
+// ошибкой.
+class AsyncIo
+{
+public:
+	using ReadHandler = std::function<void(std::unique_ptr<SourceFile> file, std::exception_ptr error)>;
+	using WriteHandler = std::function<void(std::exception_ptr error)>;
+
+	// Данные должны жить до вызова обработчика записи. Каталог файла
+	// создает вызывающий: поток ввода-вывода не делает блокирующих вызовов
+	struct WriteRequest
+	{
+		std::string filePath;
+		const unsigned char* data = nullptr;
+		size_t size = 0;
+	};
+
+	explicit AsyncIo(size_t maxInFlight);
+	~AsyncIo();
+
+	AsyncIo(const AsyncIo&) = delete;
+	AsyncIo& operator=(const AsyncIo&) = delete;
+
+	void Read(const std::string& filePath, ReadHandler onRead);
+	// Обработчик вызывается один раз, когда записаны все файлы; при ошибках
+	// получает первую из них
+	void Write(std::vector<WriteRequest> requests, WriteHandler onWritten);
+
+private:
+	struct Operation;
+	struct WriteGroup;
+	struct FixedBuffers;
+
+	void Post(std::vector<std::unique_ptr<Operation>> operations);
+	void Run();
+	void ArmWakeup();
+	void StartQueued();
+	void Start(Operation* operation);
+	void HandleCompletion(Operation* operation, int step, int result);
+	void ContinueRead(Operation* operation);
+	void ContinueWrite(Operation* operation);
+	void Finish(Operation* operation, std::exception_ptr error);
+	void Complete(Operation& operation, std::exception_ptr error);
+	void Fail(std::exception_ptr error);
+	void CloseFile(int fd);
+	io_uring_sqe* GetSqe();
+
+	IoRing m_ring;
+	std::shared_ptr<FixedBuffers> m_fixedBuffers;
+	size_t m_maxInFlight;
+	size_t m_inFlight = 0;
+	std::unordered_set<Operation*> m_started;
+	int m_wakeupFd = -1;
+	uint64_t m_wakeupValue = 0;
+
+	std::mutex m_mutex;
+	std::deque<std::unique_ptr<Operation>> m_queue;
+	bool m_isStopping = false;
+	std::exception_ptr m_error;
+	std::thread m_thread;
+};
\ No newline at end of file
@@ -0,0 +1,371 @@
+#include "BufferArena.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cstdlib>
+#include <cstring>
+#include <linux/mempolicy.h>
+#include <map>
+#include <mutex>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+constexpr size_t HEADER_SIZE = 64;
+constexpr size_t ARENA_THRESHOLD = 128 * 1024;
+constexpr size_t PAGE_SIZE = 4096;
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+// Пределы на весь процесс, а не на поток или узел: без --max-memory
+// удерживаемая память не растет вместе с -j. Общий для кешей потоков предел
+// делится поровну между живыми потоками
+constexpr size_t THREAD_CACHES_LIMIT = 1024 * 1024 * 1024;
+constexpr size_t SHARED_POOLS_LIMIT = 512 * 1024 * 1024;
+// Узлы с большими номерами делят пулы по модулю
+constexpr int MAX_NODES = 8;
+
+enum class BlockKind
+{
+	Heap,
+	Mapped,
+};
+
+class ThreadCache;
+
+struct alignas(HEADER_SIZE) BlockHeader
+{
+	size_t capacity;
+	size_t mappingSize;
+	BlockKind kind;
+	int node;
+	const ThreadCache* owner;
+};
+
+using FreeBlocks = std::multimap<size_t, BlockHeader*>;
+
+std::atomic<size_t> g_systemAllocations = 0;
+std::atomic<size_t> g_reusedAllocations = 0;
+std::atomic<bool> g_hugePagesUnavailable = false;
+std::atomic<size_t> g_threadCachesLimit = THREAD_CACHES_LIMIT;
+std::atomic<size_t> g_threadCacheCount = 0;
+std::atomic<size_t> g_sharedPoolsLimit = SHARED_POOLS_LIMIT;
+std::atomic<size_t> g_sharedCachedBytes = 0;
+
+// Узел NUMA, к которому привязан поток; -1, если поток не закреплен
+thread_local int t_node = -1;
+
+BlockHeader* HeaderOf(void* ptr)
+{
+	return reinterpret_cast<BlockHeader*>(static_cast<unsigned char*>(ptr) - HEADER_SIZE);
+}
+
+void* PayloadOf(BlockHeader* header)
+{
+	return reinterpret_cast<unsigned char*>(header) + HEADER_SIZE;
+}
+
+size_t RoundUp(size_t value, size_t granularity)
+{
+	return (value + granularity - 1) / granularity * granularity;
+}
+
+// Четыре класса размера на каждую степень двойки: потери не больше 25%,
+// зато изображения близких размеров попадают в один и тот же блок
+size_t GetMappingSize(size_t size)
+{
+	const size_t total = size + HEADER_SIZE;
+	const size_t granularity = std::max(PAGE_SIZE, std::bit_floor(total) / 4);
+	const size_t mappingSize = RoundUp(total, granularity);
+	return mappingSize >= HUGE_PAGE_SIZE ? RoundUp(mappingSize, HUGE_PAGE_SIZE) : mappingSize;
+}
+
+// Страницы выделяются при первой записи, обычно на узле закрепленного потока;
+// политика закрепляет это и за страницами, которых первым коснется другой
+void BindToNode(void* mapping, size_t mappingSize, int node)
+{
+	if (node < 0 || node >= static_cast<int>(sizeof(unsigned long) * 8))
+	{
+		return;
+	}
+	const unsigned long nodeMask = 1UL << node;
+	syscall(SYS_mbind, mapping, mappingSize, MPOL_PREFERRED, &nodeMask, sizeof(nodeMask) * 8, 0);
+}
+
+void* MapHugePages(size_t mappingSize)
+{
+#ifdef MAP_HUGETLB
+	if (mappingSize % HUGE_PAGE_SIZE == 0 && !g_hugePagesUnavailable.load(std::memory_order_relaxed))
+	{
+		void* mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (mapping != MAP_FAILED)
+		{
+			return mapping;
+		}
+		g_hugePagesUnavailable.store(true, std::memory_order_relaxed);
+	}
+#endif
+	return nullptr;
+}
+
+BlockHeader* MapBlock(size_t size)
+{
+	const size_t mappingSize = GetMappingSize(size);
+	void* mapping = MapHugePages(mappingSize);
+	if (!mapping)
+	{
+		mapping = mmap(nullptr, mappingSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (mapping == MAP_FAILED)
+		{
+			return nullptr;
+		}
+#ifdef MADV_HUGEPAGE
+		if (mappingSize >= HUGE_PAGE_SIZE)
+		{
+			madvise(mapping, mappingSize, MADV_HUGEPAGE);
+		}
+#endif
+	}
+
+	BindToNode(mapping, mappingSize, t_node);
+	g_systemAllocations.fetch_add(1, std::memory_order_relaxed);
+	auto* header = static_cast<BlockHeader*>(mapping);
+	header->capacity = mappingSize - HEADER_SIZE;
+	header->mappingSize = mappingSize;
+	header->kind = BlockKind::Mapped;
+	header->node = t_node;
+	return header;
+}
+
+void UnmapBlock(BlockHeader* header)
+{
+	munmap(header, header->mappingSize);
+}
+
+// Берет наименьший подходящий блок, если он не слишком велик для запроса
+BlockHeader* TakeBlock(FreeBlocks& blocks, size_t& cachedBytes, size_t size)
+{
+	auto it = blocks.lower_bound(size);
+	if (it == blocks.end() || it->first > size + size / 2 + HUGE_PAGE_SIZE)
+	{
+		return nullptr;
+	}
+	BlockHeader* header = it->second;
+	cachedBytes -= header->mappingSize;
+	blocks.erase(it);
+	return header;
+}
+
+class SharedPool
+{
+public:
+	BlockHeader* Take(size_t size)
+	{
+		std::lock_guard lock(m_mutex);
+		BlockHeader* header = TakeBlock(m_blocks, m_cachedBytes, size);
+		if (header)
+		{
+			g_sharedCachedBytes.fetch_sub(header->mappingSize, std::memory_order_relaxed);
+		}
+		return header;
+	}
+
+	void Put(BlockHeader* header)
+	{
+		// Место резервируется в общем для всех узлов счетчике
+		const size_t cachedBytes = g_sharedCachedBytes.fetch_add(header->mappingSize, std::memory_order_relaxed) + header->mappingSize;
+		if (cachedBytes > g_sharedPoolsLimit.load(std::memory_order_relaxed))
+		{
+			g_sharedCachedBytes.fetch_sub(header->mappingSize, std::memory_order_relaxed);
+			UnmapBlock(header);
+			return;
+		}
+		std::lock_guard lock(m_mutex);
+		m_cachedBytes += header->mappingSize;
+		m_blocks.emplace(header->capacity, header);
+	}
+
+private:
+	std::mutex m_mutex;
+	FreeBlocks m_blocks;
+	size_t m_cachedBytes = 0;
+};
+
+// Блоки возвращаются в пул своего узла, а поток берет из пула своего:
+// буфер не переезжает на другой сокет при переиспользовании
+SharedPool& GetSharedPool(int node)
+{
+	static std::array<SharedPool, MAX_NODES> pools;
+	return pools[static_cast<size_t>(std::max(node, 0) % MAX_NODES)];
+}
+
+// Другие thread_local объекты (кеш сэмплеров ресайзера) могут освобождать
+// блоки уже после разрушения кеша потока: тогда блоки идут в общий пул
+thread_local bool t_isThreadCacheDestroyed = false;
+
+class ThreadCache
+{
+public:
+	ThreadCache()
+	{
+		g_threadCacheCount.fetch_add(1, std::memory_order_relaxed);
+	}
+
+	ThreadCache(const ThreadCache&) = delete;
+	ThreadCache& operator=(const ThreadCache&) = delete;
+
+	~ThreadCache()
+	{
+		t_isThreadCacheDestroyed = true;
+		g_threadCacheCount.fetch_sub(1, std::memory_order_relaxed);
+		for (const auto& [capacity, header] : m_blocks)
+		{
+			GetSharedPool(header->node).Put(header);
+		}
+	}
+
+	BlockHeader* Take(size_t size)
+	{
+		BlockHeader* header = TakeBlock(m_blocks, m_cachedBytes, size);
+		return header ? header : GetSharedPool(t_node).Take(size);
+	}
+
+	void Put(BlockHeader* header)
+	{
+		const size_t limit = g_threadCachesLimit.load(std::memory_order_relaxed) / std::max<size_t>(1, g_threadCacheCount.load(std::memory_order_relaxed));
+		if (m_cachedBytes + header->mappingSize > limit)
+		{
+			GetSharedPool(header->node).Put(header);
+			return;
+		}
+		m_cachedBytes += header->mappingSize;
+		m_blocks.emplace(header->capacity, header);
+	}
+
+private:
+	FreeBlocks m_blocks;
+	size_t m_cachedBytes = 0;
+};
+
+ThreadCache* GetThreadCache()
+{
+	if (t_isThreadCacheDestroyed)
+	{
+		return nullptr;
+	}
+	thread_local ThreadCache cache;
+	return &cache;
+}
+
+void* AllocateFromHeap(size_t size)
+{
+	auto* header = static_cast<BlockHeader*>(std::malloc(size + HEADER_SIZE));
+	if (!header)
+	{
+		return nullptr;
+	}
+	header->capacity = size;
+	header->mappingSize = 0;
+	header->kind = BlockKind::Heap;
+	header->node = -1;
+	header->owner = nullptr;
+	return PayloadOf(header);
+}
+} // namespace
+
+namespace BufferArena
+{
+void* Allocate(size_t size)
+{
+	if (size < ARENA_THRESHOLD)
+	{
+		return AllocateFromHeap(size);
+	}
+
+	ThreadCache* cache = GetThreadCache();
+	BlockHeader* header = cache ? cache->Take(size) : GetSharedPool(t_node).Take(size);
+	if (header)
+	{
+		g_reusedAllocations.fetch_add(1, std::memory_order_relaxed);
+	}
+	else
+	{
+		header = MapBlock(size);
+	}
+	if (!header)
+	{
+		return nullptr;
+	}
+	header->owner = cache;
+	return PayloadOf(header);
+}
+
+void* Reallocate(void* ptr, size_t newSize)
+{
+	if (!ptr)
+	{
+		return Allocate(newSize);
+	}
+
+	BlockHeader* header = HeaderOf(ptr);
+	if (newSize <= header->capacity && (header->kind != BlockKind::Heap || newSize >= header->capacity / 2))
+	{
+		return ptr;
+	}
+
+	void* result = Allocate(newSize);
+	if (result)
+	{
+		std::memcpy(result, ptr, std::min(header->capacity, newSize));
+		Free(ptr);
+	}
+	return result;
+}
+
+void Free(void* ptr)
+{
+	if (!ptr)
+	{
+		return;
+	}
+
+	BlockHeader* header = HeaderOf(ptr);
+	if (header->kind == BlockKind::Heap)
+	{
+		std::free(header);
+		return;
+	}
+
+	// В конвейере буфер декодера освобождает поток масштабирования: такой блок
+	// отдаем в общий пул, чтобы он вернулся к потокам, которые его выделяют
+	ThreadCache* cache = GetThreadCache();
+	if (cache && header->owner == cache)
+	{
+		cache->Put(header);
+	}
+	else
+	{
+		GetSharedPool(header->node).Put(header);
+	}
+}
+
+void SetThreadNode(int node)
+{
+	t_node = node;
+}
+
+void LimitCache(size_t bytes)
+{
+	g_threadCachesLimit.store(0, std::memory_order_relaxed);
+	g_sharedPoolsLimit.store(bytes, std::memory_order_relaxed);
+}
+
+Stats GetStats()
+{
+	return {
+		g_systemAllocations.load(std::memory_order_relaxed),
+		g_reusedAllocations.load(std::memory_order_relaxed)};
+}
+} // namespace BufferArena
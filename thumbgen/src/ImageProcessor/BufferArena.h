@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+// Аллокатор для буферов декодера и ресайзера (хуки STBI_MALLOC/STBIR_MALLOC).
+// Крупные блоки не возвращаются системе, а кешируются в потоке, который их
+// выделил, и переиспользуются для следующих изображений; блоки, освобожденные
+// чужим потоком или не поместившиеся в кеш, уходят в общий пул. Блоки
+// выделяются через mmap, по возможности на huge pages, и у закрепленных
+// потоков - на их узле NUMA; общий пул свой у каждого узла. Объем кешей
+// потоков и общих пулов ограничен на весь процесс, а не на поток.
+namespace BufferArena
+{
+struct Stats
+{
+	size_t systemAllocations = 0;
+	size_t reusedAllocations = 0;
+};
+
+void* Allocate(size_t size);
+void* Reallocate(void* ptr, size_t newSize);
+void Free(void* ptr);
+// Все освобожденные блоки идут в общие пулы, которые вместе держат не
+// больше bytes. Вызывается до запуска рабочих потоков
+void LimitCache(size_t bytes);
+// Блоки, которые поток выделит дальше, размещаются на узле node
+void SetThreadNode(int node);
+
+Stats GetStats();
+} // namespace BufferArena
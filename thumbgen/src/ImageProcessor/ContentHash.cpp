@@ -0,0 +1,38 @@
+#include "ContentHash.h"
+
+#include <bit>
+#include <cstring>
+
+namespace
+{
+constexpr uint64_t HASH_MULTIPLIER = 0x9E3779B97F4A7C15ULL;
+
+uint64_t Mix(uint64_t value)
+{
+	value ^= value >> 33;
+	value *= 0xFF51AFD7ED558CCDULL;
+	value ^= value >> 33;
+	value *= 0xC4CEB9FE1A85EC53ULL;
+	value ^= value >> 33;
+	return value;
+}
+} // namespace
+
+uint64_t HashContent(const void* data, size_t size, uint64_t seed)
+{
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	uint64_t hash = Mix(seed ^ (size * HASH_MULTIPLIER));
+	for (; size >= sizeof(uint64_t); bytes += sizeof(uint64_t), size -= sizeof(uint64_t))
+	{
+		uint64_t word;
+		std::memcpy(&word, bytes, sizeof(word));
+		hash = std::rotl(hash ^ Mix(word), 27) * HASH_MULTIPLIER;
+	}
+
+	uint64_t tail = 0;
+	if (size > 0)
+	{
+		std::memcpy(&tail, bytes, size);
+	}
+	return Mix(hash ^ Mix(tail));
+}
\ No newline at end of file
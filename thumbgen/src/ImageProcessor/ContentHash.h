@@ -0,0 +1,8 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Быстрый некриптографический 64-битный хеш: сравнение содержимого файлов
+// и отпечатки параметров
+uint64_t HashContent(const void* data, size_t size, uint64_t seed = 0);
\ No newline at end of file
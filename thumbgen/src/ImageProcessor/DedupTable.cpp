@@ -0,0 +1,84 @@
+#include "DedupTable.h"
+
+DedupTable::Original::Original(std::string filePath)
+	: m_filePath(std::move(filePath))
+{
+}
+
+const std::string& DedupTable::Original::GetFilePath() const
+{
+	return m_filePath;
+}
+
+DedupTable::Outputs DedupTable::Original::Wait()
+{
+	std::unique_lock lock(m_mutex);
+	m_published.wait(lock, [this] {
+		return m_isPublished;
+	});
+	return m_outputs;
+}
+
+bool DedupTable::Original::Defer(Continuation continuation)
+{
+	std::lock_guard lock(m_mutex);
+	if (m_isPublished)
+	{
+		return false;
+	}
+	m_deferred.push_back(std::move(continuation));
+	return true;
+}
+
+// Отложенные продолжения выполняются в потоке владельца, вне блокировки
+void DedupTable::Original::Publish(Outputs outputs)
+{
+	std::vector<Continuation> deferred;
+	{
+		std::lock_guard lock(m_mutex);
+		m_outputs = std::move(outputs);
+		m_isPublished = true;
+		deferred.swap(m_deferred);
+	}
+	m_published.notify_all();
+
+	for (const auto& continuation : deferred)
+	{
+		continuation(m_outputs);
+	}
+}
+
+DedupTable::Claim::Claim(std::shared_ptr<Original> original)
+	: m_original(std::move(original))
+{
+}
+
+DedupTable::Claim::~Claim()
+{
+	if (!m_isPublished)
+	{
+		m_original->Publish({});
+	}
+}
+
+void DedupTable::Claim::Publish(Outputs outputs)
+{
+	m_isPublished = true;
+	m_original->Publish(std::move(outputs));
+}
+
+DedupTable::Lookup DedupTable::Acquire(uint64_t contentHash, uint64_t size, const std::string& filePath)
+{
+	const Key key{contentHash, size};
+	Shard& shard = m_shards[contentHash % SHARD_COUNT];
+
+	std::lock_guard lock(shard.mutex);
+	const auto [it, isInserted] = shard.entries.try_emplace(key, nullptr);
+	if (!isInserted)
+	{
+		return {nullptr, it->second};
+	}
+
+	it->second = std::make_shared<Original>(filePath);
+	return {std::make_unique<Claim>(it->second), nullptr};
+}
\ No newline at end of file
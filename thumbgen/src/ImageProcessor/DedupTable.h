@@ -0,0 +1,98 @@
+#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Таблица уже встреченного содержимого исходников (хеш и размер). Первая
+// задача с таким содержимым становится владельцем и публикует пути своих
+// миниатюр; дубликаты берут их вместо повторной обработки.
+class DedupTable
+{
+public:
+	// Пути миниатюр по порядку размеров; пусто, если владелец не справился
+	using Outputs = std::vector<std::string>;
+	using Continuation = std::function<void(const Outputs& outputs)>;
+
+	class Original
+	{
+	public:
+		explicit Original(std::string filePath);
+
+		const std::string& GetFilePath() const;
+		Outputs Wait();
+		// Откладывает продолжение до публикации; false, если результат уже
+		// опубликован и его можно сразу взять через Wait
+		bool Defer(Continuation continuation);
+
+	private:
+		friend class DedupTable;
+		void Publish(Outputs outputs);
+
+		std::string m_filePath;
+		std::mutex m_mutex;
+		std::condition_variable m_published;
+		bool m_isPublished = false;
+		Outputs m_outputs;
+		std::vector<Continuation> m_deferred;
+	};
+
+	// Обязанность владельца опубликовать результат. Если задача упала и
+	// Claim разрушен без Publish, дубликаты получают пустой результат
+	class Claim
+	{
+	public:
+		explicit Claim(std::shared_ptr<Original> original);
+		~Claim();
+
+		Claim(const Claim&) = delete;
+		Claim& operator=(const Claim&) = delete;
+
+		void Publish(Outputs outputs);
+
+	private:
+		std::shared_ptr<Original> m_original;
+		bool m_isPublished = false;
+	};
+
+	struct Lookup
+	{
+		std::unique_ptr<Claim> claim;
+		std::shared_ptr<Original> original;
+	};
+
+	Lookup Acquire(uint64_t contentHash, uint64_t size, const std::string& filePath);
+
+private:
+	constexpr static size_t SHARD_COUNT = 64;
+
+	struct Key
+	{
+		uint64_t contentHash;
+		uint64_t size;
+
+		bool operator==(const Key&) const = default;
+	};
+
+	struct KeyHash
+	{
+		size_t operator()(const Key& key) const
+		{
+			return static_cast<size_t>(key.contentHash ^ (key.size * 0x9E3779B97F4A7C15ULL));
+		}
+	};
+
+	struct Shard
+	{
+		std::mutex mutex;
+		std::unordered_map<Key, std::shared_ptr<Original>, KeyHash> entries;
+	};
+
+	std::array<Shard, SHARD_COUNT> m_shards;
+};
\ No newline at end of file
@@ -0,0 +1,233 @@
+#include "ExifThumbnail.h"
+#include "stb_image.h"
+
+#include <cstdint>
+#include <cstring>
+
+namespace
+{
+constexpr unsigned char MARKER_SOI = 0xD8;
+constexpr unsigned char MARKER_EOI = 0xD9;
+constexpr unsigned char MARKER_SOS = 0xDA;
+constexpr unsigned char MARKER_APP1 = 0xE1;
+constexpr uint16_t TAG_THUMBNAIL_OFFSET = 0x0201;
+constexpr uint16_t TAG_THUMBNAIL_LENGTH = 0x0202;
+constexpr char EXIF_SIGNATURE[] = {'E', 'x', 'i', 'f', 0, 0};
+
+bool IsStartOfFrame(unsigned char marker)
+{
+	return marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+}
+
+class TiffReader
+{
+public:
+	TiffReader(const unsigned char* data, size_t size)
+		: m_data(data)
+		, m_size(size)
+	{
+	}
+
+	bool ReadByteOrder()
+	{
+		if (m_size < 8)
+		{
+			return false;
+		}
+		if (m_data[0] == 'I' && m_data[1] == 'I')
+		{
+			m_littleEndian = true;
+		}
+		else if (m_data[0] != 'M' || m_data[1] != 'M')
+		{
+			return false;
+		}
+		return Read16(2) == 42;
+	}
+
+	bool Contains(size_t offset, size_t length) const
+	{
+		return offset <= m_size && length <= m_size - offset;
+	}
+
+	uint16_t Read16(size_t offset) const
+	{
+		const unsigned char* p = m_data + offset;
+		return m_littleEndian ? p[0] | (p[1] << 8) : (p[0] << 8) | p[1];
+	}
+
+	uint32_t Read32(size_t offset) const
+	{
+		const unsigned char* p = m_data + offset;
+		return m_littleEndian
+			? p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24)
+			: (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+	}
+
+	const unsigned char* Data() const
+	{
+		return m_data;
+	}
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	bool m_littleEndian = false;
+};
+
+// IFD0 описывает основное изображение, IFD1 (следующий за ним) - миниатюру
+std::optional<std::vector<unsigned char>> ExtractThumbnail(const unsigned char* tiff, size_t size)
+{
+	TiffReader reader(tiff, size);
+	if (!reader.ReadByteOrder())
+	{
+		return std::nullopt;
+	}
+
+	size_t ifd0 = reader.Read32(4);
+	if (!reader.Contains(ifd0, 2))
+	{
+		return std::nullopt;
+	}
+	size_t ifd0Entries = reader.Read16(ifd0);
+	size_t nextIfdPos = ifd0 + 2 + ifd0Entries * 12;
+	if (!reader.Contains(nextIfdPos, 4))
+	{
+		return std::nullopt;
+	}
+
+	size_t ifd1 = reader.Read32(nextIfdPos);
+	if (ifd1 == 0 || !reader.Contains(ifd1, 2))
+	{
+		return std::nullopt;
+	}
+
+	size_t ifd1Entries = reader.Read16(ifd1);
+	if (!reader.Contains(ifd1 + 2, ifd1Entries * 12))
+	{
+		return std::nullopt;
+	}
+
+	uint32_t thumbOffset = 0;
+	uint32_t thumbLength = 0;
+	for (size_t i = 0; i < ifd1Entries; ++i)
+	{
+		size_t entry = ifd1 + 2 + i * 12;
+		uint16_t tag = reader.Read16(entry);
+		if (tag == TAG_THUMBNAIL_OFFSET)
+		{
+			thumbOffset = reader.Read32(entry + 8);
+		}
+		else if (tag == TAG_THUMBNAIL_LENGTH)
+		{
+			thumbLength = reader.Read32(entry + 8);
+		}
+	}
+
+	if (thumbLength == 0 || !reader.Contains(thumbOffset, thumbLength))
+	{
+		return std::nullopt;
+	}
+
+	const unsigned char* begin = reader.Data() + thumbOffset;
+	return std::vector<unsigned char>(begin, begin + thumbLength);
+}
+
+class JpegSegmentReader
+{
+public:
+	JpegSegmentReader(const unsigned char* data, size_t size)
+		: m_data(data)
+		, m_size(size)
+	{
+	}
+
+	bool ReadMarker(unsigned char& marker)
+	{
+		if (m_pos >= m_size || m_data[m_pos] != 0xFF)
+		{
+			return false;
+		}
+		while (m_pos < m_size && m_data[m_pos] == 0xFF)
+		{
+			++m_pos;
+		}
+		if (m_pos >= m_size)
+		{
+			return false;
+		}
+		marker = m_data[m_pos++];
+		return true;
+	}
+
+	bool ReadPayload(const unsigned char*& payload, size_t& payloadSize)
+	{
+		if (m_size - m_pos < 2)
+		{
+			return false;
+		}
+		const size_t length = (m_data[m_pos] << 8) | m_data[m_pos + 1];
+		if (length < 2 || length > m_size - m_pos)
+		{
+			return false;
+		}
+		payload = m_data + m_pos + 2;
+		payloadSize = length - 2;
+		m_pos += length;
+		return true;
+	}
+
+private:
+	const unsigned char* m_data;
+	size_t m_size;
+	size_t m_pos = 0;
+};
+} // namespace
+
+std::optional<ExifThumbnail> ReadExifThumbnail(const unsigned char* data, size_t size)
+{
+	JpegSegmentReader reader(data, size);
+	unsigned char marker = 0;
+	if (!reader.ReadMarker(marker) || marker != MARKER_SOI)
+	{
+		return std::nullopt;
+	}
+
+	std::optional<std::vector<unsigned char>> jpegData;
+	while (reader.ReadMarker(marker) && marker != MARKER_SOS && marker != MARKER_EOI)
+	{
+		const unsigned char* payload = nullptr;
+		size_t payloadSize = 0;
+		if (!reader.ReadPayload(payload, payloadSize))
+		{
+			return std::nullopt;
+		}
+
+		if (IsStartOfFrame(marker))
+		{
+			if (!jpegData || payloadSize < 5)
+			{
+				return std::nullopt;
+			}
+
+			ExifThumbnail thumbnail;
+			thumbnail.imageHeight = (payload[1] << 8) | payload[2];
+			thumbnail.imageWidth = (payload[3] << 8) | payload[4];
+			int channels = 0;
+			if (!stbi_info_from_memory(jpegData->data(), static_cast<int>(jpegData->size()), &thumbnail.width, &thumbnail.height, &channels))
+			{
+				return std::nullopt;
+			}
+			thumbnail.jpegData = std::move(*jpegData);
+			return thumbnail;
+		}
+
+		if (marker == MARKER_APP1 && !jpegData && payloadSize > sizeof(EXIF_SIGNATURE)
+			&& std::memcmp(payload, EXIF_SIGNATURE, sizeof(EXIF_SIGNATURE)) == 0)
+		{
+			jpegData = ExtractThumbnail(payload + sizeof(EXIF_SIGNATURE), payloadSize - sizeof(EXIF_SIGNATURE));
+		}
+	}
+
+	return std::nullopt;
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+struct ExifThumbnail
+{
+	std::vector<unsigned char> jpegData;
+	int width = 0;
+	int height = 0;
+	int imageWidth = 0;
+	int imageHeight = 0;
+};
+
+std::optional<ExifThumbnail> ReadExifThumbnail(const unsigned char* data, size_t size);
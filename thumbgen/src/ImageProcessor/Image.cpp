@@ -1,7 +1,9 @@
 #include "Image.h"
+#include "BufferArena.h"
 #include "stb_image.h"
 
 #include <stdexcept>
+#include <string>
 
 namespace
 {
@@ -9,11 +11,23 @@ void AssertIsValidFileSource(const unsigned char* data)
 {
 	if (!data)
 	{
-		throw std::runtime_error("Ошибка загрузки изображения");
+		throw DecodeError(stbi_failure_reason());
 	}
 }
 } // namespace
 
+// Причины stb_image - строковые литералы, их можно хранить указателем
+DecodeError::DecodeError(const char* reason)
+	: std::runtime_error(reason ? std::string("Ошибка загрузки изображения: ") + reason : "Ошибка загрузки изображения")
+	, m_reason(reason)
+{
+}
+
+const char* DecodeError::GetReason() const
+{
+	return m_reason;
+}
+
 Image::Image(const std::string& filePath)
 {
 	m_data = stbi_load(filePath.c_str(), &m_width, &m_height, &m_originalChannels, 0);
@@ -21,11 +35,36 @@ Image::Image(const std::string& filePath)
 	m_channels = m_originalChannels;
 }
 
+Image::Image(const std::string& filePath, int minWidth, int minHeight)
+{
+	stbi_set_jpeg_min_size_thread(minWidth, minHeight);
+	m_data = stbi_load(filePath.c_str(), &m_width, &m_height, &m_originalChannels, 0);
+	stbi_set_jpeg_min_size_thread(0, 0);
+	AssertIsValidFileSource(m_data);
+	m_channels = m_originalChannels;
+}
+
+Image::Image(const unsigned char* buffer, size_t size)
+{
+	m_data = stbi_load_from_memory(buffer, static_cast<int>(size), &m_width, &m_height, &m_originalChannels, 0);
+	AssertIsValidFileSource(m_data);
+	m_channels = m_originalChannels;
+}
+
+Image::Image(const unsigned char* buffer, size_t size, int minWidth, int minHeight)
+{
+	stbi_set_jpeg_min_size_thread(minWidth, minHeight);
+	m_data = stbi_load_from_memory(buffer, static_cast<int>(size), &m_width, &m_height, &m_originalChannels, 0);
+	stbi_set_jpeg_min_size_thread(0, 0);
+	AssertIsValidFileSource(m_data);
+	m_channels = m_originalChannels;
+}
+
 Image::~Image()
 {
 	if (m_data)
 	{
-		stbi_image_free(m_data);
+		BufferArena::Free(m_data);
 	}
 }
 
@@ -1,11 +1,28 @@
 #pragma once
 
+#include <cstddef>
+#include <stdexcept>
 #include <string>
 
+// Исходник не декодировался. Причина - строка stb_image, если она есть
+class DecodeError : public std::runtime_error
+{
+public:
+	explicit DecodeError(const char* reason);
+
+	const char* GetReason() const;
+
+private:
+	const char* m_reason;
+};
+
 class Image
 {
 public:
 	explicit Image(const std::string& filePath);
+	Image(const std::string& filePath, int minWidth, int minHeight);
+	Image(const unsigned char* buffer, size_t size);
+	Image(const unsigned char* buffer, size_t size, int minWidth, int minHeight);
 	~Image();
 
 	Image(const Image&) = delete;
@@ -0,0 +1,717 @@
+#include "ImageProcessor.h"
+#include "ContentHash.h"
+#include "ExifThumbnail.h"
+#include "Progress.h"
+#include "ResizeCache.h"
+#include "StageStats.h"
+#include "TextUtils.h"
+#include "stb_image.h"
+#include "stb_image_write.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fcntl.h>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <stdexcept>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/fs.h>
+#endif
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr int JPEG_QUALITY = 90;
+constexpr double MAX_PREVIEW_ASPECT_ERROR = 0.02;
+// Декодер JPEG уменьшает при декодировании не больше чем в 8 раз
+constexpr int MAX_JPEG_SCALE_SHIFT = 3;
+// Рядом с результатом декодер держит плоскости компонент или распакованный
+// поток PNG того же порядка размера
+constexpr size_t DECODE_MEMORY_FACTOR = 2;
+constexpr size_t HEADER_PROBE_SIZE = 256 * 1024;
+
+using ImageProcessor::OutputSpec;
+using ImageProcessor::Rendition;
+using ImageProcessor::Size;
+using ImageProcessor::ThumbnailSource;
+using ImageProcessor::ThumbnailTask;
+
+Size FitSize(int width, int height, int maxWidth, int maxHeight)
+{
+	if (width <= maxWidth && height <= maxHeight)
+	{
+		return {width, height};
+	}
+
+	const double scale = std::min(static_cast<double>(maxWidth) / width, static_cast<double>(maxHeight) / height);
+	return {
+		std::max(1, static_cast<int>(width * scale)),
+		std::max(1, static_cast<int>(height * scale))};
+}
+
+long long GetArea(Size size)
+{
+	return static_cast<long long>(size.width) * size.height;
+}
+
+// Декодированное изображение должно покрывать все размеры сразу
+Size GetDecodeSize(const std::vector<Rendition>& renditions)
+{
+	Size decodeSize;
+	for (const auto& rendition : renditions)
+	{
+		decodeSize.width = std::max(decodeSize.width, rendition.maxSize.width);
+		decodeSize.height = std::max(decodeSize.height, rendition.maxSize.height);
+	}
+	return decodeSize;
+}
+
+void FitRenditions(std::vector<Rendition>& renditions, int width, int height)
+{
+	for (auto& rendition : renditions)
+	{
+		rendition.size = FitSize(width, height, rendition.maxSize.width, rendition.maxSize.height);
+	}
+	std::ranges::stable_sort(renditions, [](const Rendition& lhs, const Rendition& rhs) {
+		return GetArea(lhs.size) > GetArea(rhs.size);
+	});
+}
+
+std::string MakeOutputPath(const fs::path& relativePath, const fs::path& outputDir, const OutputSpec& output)
+{
+	// Пустой {dir} дал бы абсолютный путь "/name.ext"
+	const fs::path dir = relativePath.has_parent_path() ? relativePath.parent_path() : fs::path(".");
+	std::string layout = output.layout;
+	layout = ReplaceAll(layout, "{dir}", dir.string());
+	layout = ReplaceAll(layout, "{name}", relativePath.stem().string());
+	layout = ReplaceAll(layout, "{ext}", relativePath.extension().string());
+	layout = ReplaceAll(layout, "{w}", std::to_string(output.maxSize.width));
+	layout = ReplaceAll(layout, "{h}", std::to_string(output.maxSize.height));
+	return (outputDir / fs::path(layout).lexically_normal()).string();
+}
+
+bool IsJpeg(const fs::path& path)
+{
+	std::string extension = path.extension().string();
+	std::ranges::transform(extension, extension.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+	return extension == ".jpg" || extension == ".jpeg";
+}
+
+void AssertIsOpened(const std::ios& stream, const std::string& path)
+{
+	if (!stream)
+	{
+		throw std::runtime_error("Не удалось открыть файл: " + path);
+	}
+}
+
+void AssertIsResized(bool result)
+{
+	if (!result)
+	{
+		throw std::runtime_error("Ошибка изменения размера изображения");
+	}
+}
+
+void AssertIsEncoded(int result, const std::string& outputPath)
+{
+	if (!result)
+	{
+		throw std::runtime_error("Ошибка кодирования изображения: " + outputPath);
+	}
+}
+
+void AssertIsWritten(const std::ios& stream, const std::string& outputPath)
+{
+	if (!stream)
+	{
+		throw std::runtime_error("Ошибка записи изображения: " + outputPath);
+	}
+}
+
+void AppendToBuffer(void* context, void* data, int size)
+{
+	auto* buffer = static_cast<std::vector<unsigned char>*>(context);
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	buffer->insert(buffer->end(), bytes, bytes + size);
+}
+
+bool HasSameAspect(int width, int height, int otherWidth, int otherHeight)
+{
+	const double aspect = static_cast<double>(width) / height;
+	const double otherAspect = static_cast<double>(otherWidth) / otherHeight;
+	return std::abs(aspect - otherAspect) <= MAX_PREVIEW_ASPECT_ERROR * otherAspect;
+}
+
+// Превью из EXIF годится, только если оно не меньше самой крупной миниатюры
+// и без полей: у камер с кадром 3:2 превью 160x120 дополнено черными полосами
+bool IsPreviewUsable(const ExifThumbnail& preview, const std::vector<Rendition>& renditions)
+{
+	const auto coversRendition = [&preview](const Rendition& rendition) {
+		return preview.width >= rendition.size.width && preview.height >= rendition.size.height;
+	};
+	return std::ranges::all_of(renditions, coversRendition)
+		&& HasSameAspect(preview.width, preview.height, preview.imageWidth, preview.imageHeight);
+}
+
+bool TryDecodeExifPreview(ThumbnailTask& task)
+{
+	const auto preview = ReadExifThumbnail(task.sourceFile->GetData(), task.sourceFile->GetSize());
+	if (!preview)
+	{
+		return false;
+	}
+
+	FitRenditions(task.renditions, preview->imageWidth, preview->imageHeight);
+	if (!IsPreviewUsable(*preview, task.renditions))
+	{
+		return false;
+	}
+
+	// Испорченное превью не повод терять файл: основное изображение
+	// декодируется целиком
+	try
+	{
+		task.image = std::make_unique<Image>(preview->jpegData.data(), preview->jpegData.size());
+	}
+	catch (const DecodeError&)
+	{
+		return false;
+	}
+	task.source = ThumbnailSource::ExifPreview;
+	return true;
+}
+
+// Меньший размер масштабируется из наименьшего уже готового, который
+// покрывает его по обеим сторонам, а если такого нет - из исходника
+const Rendition* FindCascadeSource(const std::vector<Rendition>& renditions, size_t index)
+{
+	const Size size = renditions[index].size;
+	for (size_t i = index; i-- > 0;)
+	{
+		if (renditions[i].size.width >= size.width && renditions[i].size.height >= size.height)
+		{
+			return &renditions[i];
+		}
+	}
+	return nullptr;
+}
+
+void ReleaseBuffer(std::vector<unsigned char>& buffer)
+{
+	std::vector<unsigned char>().swap(buffer);
+}
+
+// Копия, разделяющая блоки с оригиналом (btrfs, xfs); false, если ФС не умеет
+bool TryReflink(const std::string& fromPath, const std::string& toPath)
+{
+#ifdef FICLONE
+	const int from = open(fromPath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (from < 0)
+	{
+		return false;
+	}
+	const int to = open(toPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	const bool isCloned = to >= 0 && ioctl(to, FICLONE, from) == 0;
+	if (to >= 0)
+	{
+		close(to);
+	}
+	close(from);
+	if (!isCloned)
+	{
+		unlink(toPath.c_str());
+	}
+	return isCloned;
+#else
+	return false;
+#endif
+}
+
+// Жесткая ссылка, если оригинал на той же ФС, иначе reflink, иначе копия
+void LinkOutput(const std::string& originalPath, const std::string& outputPath)
+{
+	fs::create_directories(fs::path(outputPath).parent_path());
+
+	std::error_code error;
+	fs::remove(outputPath, error);
+	fs::create_hard_link(originalPath, outputPath, error);
+	if (!error || TryReflink(originalPath, outputPath))
+	{
+		return;
+	}
+
+	fs::copy_file(originalPath, outputPath, fs::copy_options::overwrite_existing, error);
+	if (error)
+	{
+		throw std::runtime_error("Не удалось скопировать миниатюру дубликата: " + outputPath);
+	}
+}
+
+DedupTable::Outputs GetOutputsBySpec(const std::vector<Rendition>& renditions)
+{
+	DedupTable::Outputs outputs(renditions.size());
+	for (const auto& rendition : renditions)
+	{
+		outputs[rendition.specIndex] = rendition.outputPath;
+	}
+	return outputs;
+}
+
+void PublishOutputs(ThumbnailTask& task)
+{
+	if (task.dedupClaim)
+	{
+		task.dedupClaim->Publish(GetOutputsBySpec(task.renditions));
+		task.dedupClaim.reset();
+	}
+}
+
+// Оригинал уже обрабатывается в другом потоке пула и ни от кого не
+// зависит, так что дубликат может его дождаться
+void WaitForOriginal(ThumbnailTask& task, DedupTable& table)
+{
+	ImageProcessor::LookupDuplicate(task, table);
+	if (task.original)
+	{
+		ImageProcessor::UseOriginalOutputs(task, task.original->Wait());
+	}
+}
+
+// Выбирает уменьшение так же, как декодер JPEG для заданного минимального размера
+int GetJpegScaleShift(int width, int height, Size decodeSize)
+{
+	int shift = 0;
+	while (shift < MAX_JPEG_SCALE_SHIFT && (width >> (shift + 1)) >= decodeSize.width && (height >> (shift + 1)) >= decodeSize.height)
+	{
+		++shift;
+	}
+	return shift;
+}
+
+struct SourceHeader
+{
+	int width = 0;
+	int height = 0;
+	int channels = 0;
+	bool isProgressive = false;
+};
+
+// Прогрессивный JPEG декодер собирает в коэффициентах целиком, поэтому
+// уменьшение при декодировании на них не влияет
+bool IsProgressiveJpeg(const unsigned char* data, size_t size)
+{
+	size_t pos = 2;
+	while (pos + 4 <= size && data[pos] == 0xFF)
+	{
+		const unsigned char marker = data[pos + 1];
+		if (marker == 0xFF)
+		{
+			++pos;
+			continue;
+		}
+		if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+		{
+			return marker == 0xC2 || marker == 0xC6 || marker == 0xCA || marker == 0xCE;
+		}
+		pos += 2 + ((static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3]);
+	}
+	return false;
+}
+
+std::optional<SourceHeader> ProbeHeader(const unsigned char* data, size_t size)
+{
+	SourceHeader header;
+	if (!stbi_info_from_memory(data, static_cast<int>(size), &header.width, &header.height, &header.channels))
+	{
+		return std::nullopt;
+	}
+	header.isProgressive = size > 2 && data[0] == 0xFF && data[1] == 0xD8 && IsProgressiveJpeg(data, size);
+	return header;
+}
+
+// Заголовок с сегментами метаданных перед ним без чтения всего исходника
+std::vector<unsigned char> ReadHeaderPrefix(const std::string& filePath)
+{
+	std::vector<unsigned char> prefix(HEADER_PROBE_SIZE);
+	std::ifstream file(filePath, std::ios::binary);
+	file.read(reinterpret_cast<char*>(prefix.data()), static_cast<std::streamsize>(prefix.size()));
+	prefix.resize(static_cast<size_t>(std::max<std::streamsize>(0, file.gcount())));
+	return prefix;
+}
+
+// Исходник, декодированное изображение, а для каждого размера пиксели и
+// закодированный результат не больше них
+size_t EstimateFootprint(size_t sourceSize, const SourceHeader& header, int shift, const std::vector<Rendition>& renditions)
+{
+	const size_t channels = static_cast<size_t>(header.channels);
+	const int width = header.width >> shift;
+	const int height = header.height >> shift;
+	size_t footprint = sourceSize + DECODE_MEMORY_FACTOR * static_cast<size_t>(GetArea({width, height})) * channels;
+	if (header.isProgressive)
+	{
+		footprint += sizeof(short) * static_cast<size_t>(GetArea({header.width, header.height})) * channels;
+	}
+	for (const auto& rendition : renditions)
+	{
+		const Size size = FitSize(width, height, rendition.maxSize.width, rendition.maxSize.height);
+		footprint += 2 * static_cast<size_t>(GetArea(size)) * channels;
+	}
+	return footprint;
+}
+
+// Чтение и декодирование идут в одном потоке, поэтому буфер чтения можно
+// не отдавать задаче, а держать на поток и переиспользовать
+std::vector<unsigned char>& GetThreadReadBuffer()
+{
+	thread_local std::vector<unsigned char> readBuffer;
+	return readBuffer;
+}
+} // namespace
+
+namespace ImageProcessor
+{
+ThumbnailTask MakeTask(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, const std::vector<OutputSpec>& outputs)
+{
+	ThumbnailTask task;
+	task.inputPath = inputPathStr;
+	task.startTime = StageStats::Clock::now();
+
+	const fs::path relativePath = fs::relative(inputPathStr, inputDirStr);
+	for (const auto& output : outputs)
+	{
+		Rendition rendition;
+		rendition.specIndex = task.renditions.size();
+		rendition.outputPath = MakeOutputPath(relativePath, outputDirStr, output);
+		rendition.maxSize = output.maxSize;
+		task.renditions.push_back(std::move(rendition));
+	}
+	return task;
+}
+
+void AdmitTask(ThumbnailTask& task, MemoryBudget& budget)
+{
+	size_t sourceSize = 0;
+	std::optional<SourceHeader> header;
+	if (task.sourceFile)
+	{
+		sourceSize = task.sourceFile->GetSize();
+		header = ProbeHeader(task.sourceFile->GetData(), sourceSize);
+	}
+	else
+	{
+		std::error_code error;
+		sourceSize = static_cast<size_t>(fs::file_size(task.inputPath, error));
+		const auto prefix = ReadHeaderPrefix(task.inputPath);
+		header = ProbeHeader(prefix.data(), prefix.size());
+	}
+	// Сколько нужно декодеру, неизвестно: такой файл обрабатывается один
+	if (!header)
+	{
+		task.memory = budget.Acquire(budget.GetLimit());
+		return;
+	}
+
+	const bool isJpeg = IsJpeg(task.inputPath);
+	int shift = isJpeg ? GetJpegScaleShift(header->width, header->height, GetDecodeSize(task.renditions)) : 0;
+	size_t footprint = EstimateFootprint(sourceSize, *header, shift, task.renditions);
+	while (isJpeg && footprint > budget.GetLimit() && shift < MAX_JPEG_SCALE_SHIFT)
+	{
+		++shift;
+		task.decodeSize = {std::max(1, header->width >> shift), std::max(1, header->height >> shift)};
+		footprint = EstimateFootprint(sourceSize, *header, shift, task.renditions);
+	}
+	task.memory = budget.Acquire(footprint);
+}
+
+void ReadSource(ThumbnailTask& task, const InputOptions& options, std::vector<unsigned char>* reusableBuffer)
+{
+	StageStats::ScopedTimer timer(StageStats::Stage::Read, task.inputPath, task.startTime);
+	task.sourceFile = std::make_unique<SourceFile>(task.inputPath, options, reusableBuffer);
+	StageStats::AddSource(task.inputPath, task.sourceFile->GetSize());
+	if (options.hashContent)
+	{
+		HashSource(task);
+	}
+}
+
+uint64_t HashSource(ThumbnailTask& task)
+{
+	if (task.contentHash == 0)
+	{
+		task.contentHash = HashContent(task.sourceFile->GetData(), task.sourceFile->GetSize());
+	}
+	return task.contentHash;
+}
+
+void LookupDuplicate(ThumbnailTask& task, DedupTable& table)
+{
+	const auto contentHash = HashSource(task);
+	auto lookup = table.Acquire(contentHash, task.sourceFile->GetSize(), task.inputPath);
+	task.dedupClaim = std::move(lookup.claim);
+	task.original = std::move(lookup.original);
+	if (task.original)
+	{
+		Progress::AddConsumed(task.sourceFile->GetSize());
+		task.sourceFile.reset();
+		task.memory.Release();
+	}
+}
+
+void UseOriginalOutputs(ThumbnailTask& task, DedupTable::Outputs outputs)
+{
+	// Содержимое то же, поэтому и повторная обработка упала бы так же
+	if (outputs.size() != task.renditions.size())
+	{
+		throw std::runtime_error("Не удалось обработать файл с тем же содержимым: " + task.original->GetFilePath());
+	}
+	task.originalOutputs = std::move(outputs);
+	task.source = ThumbnailSource::Duplicate;
+}
+
+void Decode(ThumbnailTask& task)
+{
+	if (task.source == ThumbnailSource::Duplicate)
+	{
+		return;
+	}
+
+	StageStats::ScopedTimer timer(StageStats::Stage::Decode, task.inputPath, task.startTime);
+	Progress::DecodeScope decodeScope;
+	Progress::AddConsumed(task.sourceFile->GetSize());
+	if (!IsJpeg(task.inputPath) || !TryDecodeExifPreview(task))
+	{
+		const Size decodeSize = task.decodeSize.width > 0 ? task.decodeSize : GetDecodeSize(task.renditions);
+		task.image = std::make_unique<Image>(task.sourceFile->GetData(), task.sourceFile->GetSize(), decodeSize.width, decodeSize.height);
+		FitRenditions(task.renditions, task.image->GetWidth(), task.image->GetHeight());
+		task.source = ThumbnailSource::Decoded;
+	}
+	task.sourceFile.reset();
+}
+
+void Resize(ThumbnailTask& task)
+{
+	if (task.source == ThumbnailSource::Duplicate)
+	{
+		return;
+	}
+
+	StageStats::ScopedTimer timer(StageStats::Stage::Resize, task.inputPath, task.startTime);
+	const Image& image = *task.image;
+	task.channels = image.GetChannels();
+	for (size_t i = 0; i < task.renditions.size(); ++i)
+	{
+		Rendition& rendition = task.renditions[i];
+		const Rendition* source = FindCascadeSource(task.renditions, i);
+		rendition.pixels.resize(static_cast<size_t>(rendition.size.width) * rendition.size.height * task.channels);
+		AssertIsResized(ResizeCache::Resize(
+			source ? source->pixels.data() : image.GetData(),
+			source ? source->size.width : image.GetWidth(),
+			source ? source->size.height : image.GetHeight(),
+			rendition.pixels.data(),
+			rendition.size.width,
+			rendition.size.height,
+			task.channels));
+	}
+	task.image.reset();
+}
+
+void Encode(ThumbnailTask& task)
+{
+	if (task.source == ThumbnailSource::Duplicate)
+	{
+		return;
+	}
+
+	StageStats::ScopedTimer timer(StageStats::Stage::Encode, task.inputPath, task.startTime);
+	for (auto& rendition : task.renditions)
+	{
+		const Size size = rendition.size;
+		const int result = IsJpeg(rendition.outputPath)
+			? stbi_write_jpg_to_func(AppendToBuffer, &rendition.encoded, size.width, size.height, task.channels, rendition.pixels.data(), JPEG_QUALITY)
+			: stbi_write_png_to_func(AppendToBuffer, &rendition.encoded, size.width, size.height, task.channels, rendition.pixels.data(), size.width * task.channels);
+		AssertIsEncoded(result, rendition.outputPath);
+		StageStats::AddOutput(task.inputPath, rendition.encoded.size());
+		ReleaseBuffer(rendition.pixels);
+	}
+}
+
+void WriteOutput(ThumbnailTask& task, PackWriter* pack)
+{
+	StageStats::ScopedTimer timer(StageStats::Stage::Write, task.inputPath, task.startTime);
+	if (task.source == ThumbnailSource::Duplicate)
+	{
+		for (const auto& rendition : task.renditions)
+		{
+			if (pack)
+			{
+				pack->Link(task.originalOutputs[rendition.specIndex], rendition.outputPath);
+			}
+			else
+			{
+				LinkOutput(task.originalOutputs[rendition.specIndex], rendition.outputPath);
+			}
+		}
+		return;
+	}
+
+	for (auto& rendition : task.renditions)
+	{
+		if (pack)
+		{
+			const auto contentHash = HashContent(rendition.encoded.data(), rendition.encoded.size());
+			pack->Append(rendition.outputPath, rendition.encoded.data(), rendition.encoded.size(), rendition.size.width, rendition.size.height, contentHash);
+			ReleaseBuffer(rendition.encoded);
+			continue;
+		}
+
+		fs::create_directories(fs::path(rendition.outputPath).parent_path());
+		// Старая миниатюра может быть жесткой ссылкой дубликата из прошлого
+		// запуска: запись поверх нее изменила бы и миниатюру дубликата
+		std::error_code error;
+		fs::remove(rendition.outputPath, error);
+
+		std::ofstream file(rendition.outputPath, std::ios::binary | std::ios::trunc);
+		AssertIsOpened(file, rendition.outputPath);
+		file.write(reinterpret_cast<const char*>(rendition.encoded.data()), static_cast<std::streamsize>(rendition.encoded.size()));
+		AssertIsWritten(file, rendition.outputPath);
+		ReleaseBuffer(rendition.encoded);
+	}
+
+	PublishOutputs(task);
+}
+
+void CreateThumbnail(const std::string& inputPath, const std::string& outputPath, int targetWidth, int targetHeight)
+{
+	ThumbnailTask task;
+	task.inputPath = inputPath;
+	task.renditions.emplace_back();
+	task.renditions.back().outputPath = outputPath;
+	task.renditions.back().maxSize = {targetWidth, targetHeight};
+	task.image = std::make_unique<Image>(inputPath, targetWidth, targetHeight);
+	FitRenditions(task.renditions, task.image->GetWidth(), task.image->GetHeight());
+
+	Resize(task);
+	Encode(task);
+	WriteOutput(task);
+}
+
+void RemoveOutputs(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, const std::vector<OutputSpec>& outputs)
+{
+	for (const auto& rendition : MakeTask(inputPathStr, inputDirStr, outputDirStr, outputs).renditions)
+	{
+		std::error_code error;
+		fs::remove(rendition.outputPath, error);
+	}
+}
+
+TaskResult ProcessTask(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, const std::vector<OutputSpec>& outputs, const InputOptions& inputOptions, DedupTable* dedupTable, PackWriter* pack, MemoryBudget* memoryBudget)
+{
+	ThumbnailTask task = MakeTask(inputPathStr, inputDirStr, outputDirStr, outputs);
+	if (memoryBudget)
+	{
+		AdmitTask(task, *memoryBudget);
+	}
+	// Буфер потока пережил бы задачу и остался вне бюджета
+	ReadSource(task, inputOptions, memoryBudget ? nullptr : &GetThreadReadBuffer());
+	if (dedupTable)
+	{
+		WaitForOriginal(task, *dedupTable);
+	}
+	Decode(task);
+	Resize(task);
+	Encode(task);
+	WriteOutput(task, pack);
+	return {task.source, task.contentHash};
+}
+
+ThumbnailTask RenderTask(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, const std::vector<OutputSpec>& outputs, const InputOptions& inputOptions, MemoryBudget* memoryBudget)
+{
+	ThumbnailTask task = MakeTask(inputPathStr, inputDirStr, outputDirStr, outputs);
+	if (memoryBudget)
+	{
+		AdmitTask(task, *memoryBudget);
+	}
+	ReadSource(task, inputOptions, memoryBudget ? nullptr : &GetThreadReadBuffer());
+	Decode(task);
+	Resize(task);
+	return task;
+}
+
+void ProcessTaskAsync(ThumbnailTask task, AsyncIo& io, const DoneHandler& onDone, DedupTable* dedupTable, MemoryBudget* memoryBudget)
+{
+	auto sharedTask = std::make_shared<ThumbnailTask>(std::move(task));
+	std::vector<AsyncIo::WriteRequest> requests;
+	try
+	{
+		// Исходник уже прочитан потоком ввода-вывода, в бюджет попадает
+		// только декодирование и дальше
+		if (memoryBudget)
+		{
+			AdmitTask(*sharedTask, *memoryBudget);
+		}
+		if (dedupTable)
+		{
+			WaitForOriginal(*sharedTask, *dedupTable);
+		}
+		Decode(*sharedTask);
+		Resize(*sharedTask);
+		Encode(*sharedTask);
+		if (sharedTask->source == ThumbnailSource::Duplicate)
+		{
+			WriteOutput(*sharedTask);
+			onDone({sharedTask->source, sharedTask->contentHash}, nullptr);
+			return;
+		}
+		// Каталоги и удаление старой миниатюры остаются рабочему потоку:
+		// в потоке ввода-вывода эти блокирующие вызовы задержали бы все
+		// остальные запросы кольца
+		for (const auto& rendition : sharedTask->renditions)
+		{
+			fs::create_directories(fs::path(rendition.outputPath).parent_path());
+			std::error_code error;
+			fs::remove(rendition.outputPath, error);
+			requests.push_back({rendition.outputPath, rendition.encoded.data(), rendition.encoded.size()});
+		}
+	}
+	catch (const std::exception&)
+	{
+		onDone({sharedTask->source, sharedTask->contentHash}, std::current_exception());
+		return;
+	}
+
+	// Запись идет в потоке ввода-вывода вперемешку с другими: стадия
+	// измеряется от отправки до записи последнего файла
+	const auto writeStartTime = StageStats::Clock::now();
+	io.Write(std::move(requests), [sharedTask, onDone, writeStartTime](std::exception_ptr error) {
+		if (!error)
+		{
+			try
+			{
+				if (StageStats::IsEnabled())
+				{
+					StageStats::Record(StageStats::Stage::Write, sharedTask->inputPath, writeStartTime);
+				}
+				PublishOutputs(*sharedTask);
+			}
+			catch (const std::exception&)
+			{
+				error = std::current_exception();
+			}
+		}
+		if (error)
+		{
+			StageStats::MarkFailed(StageStats::Stage::Write, sharedTask->inputPath, sharedTask->startTime);
+		}
+		onDone({sharedTask->source, sharedTask->contentHash}, error);
+	});
+}
+} // namespace ImageProcessor
\ No newline at end of file
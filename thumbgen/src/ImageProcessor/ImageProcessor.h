@@ -1,9 +1,111 @@
 #pragma once
 
+#include "AsyncIo.h"
+#include "DedupTable.h"
+#include "PackWriter.h"
+#include "Image.h"
+#include "MemoryBudget.h"
+#include "SourceFile.h"
+#include "StageStats.h"
+
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
 #include <string>
+#include <vector>
 
 namespace ImageProcessor
 {
+enum class ThumbnailSource
+{
+	Decoded,
+	ExifPreview,
+	Duplicate,
+};
+
+struct Size
+{
+	int width = 0;
+	int height = 0;
+};
+
+// Ограничивающий размер миниатюры и шаблон ее пути относительно выходного
+// каталога: {dir}, {name}, {ext} берутся из пути исходника, {w} и {h} из размера
+struct OutputSpec
+{
+	Size maxSize;
+	std::string layout;
+};
+
+struct Rendition
+{
+	size_t specIndex = 0;
+	std::string outputPath;
+	Size maxSize;
+	Size size;
+	std::vector<unsigned char> pixels;
+	std::vector<unsigned char> encoded;
+};
+
+// Исходник декодируется один раз на все размеры. Размеры идут от большего к
+// меньшему: каждый меньший масштабируется из уже готового большего
+struct ThumbnailTask
+{
+	std::string inputPath;
+	std::unique_ptr<SourceFile> sourceFile;
+	std::unique_ptr<Image> image;
+	ThumbnailSource source = ThumbnailSource::Decoded;
+	int channels = 0;
+	std::vector<Rendition> renditions;
+	std::unique_ptr<DedupTable::Claim> dedupClaim;
+	std::shared_ptr<DedupTable::Original> original;
+	DedupTable::Outputs originalOutputs;
+	// Меньше нужного размерам, если полное декодирование не помещается в бюджет
+	Size decodeSize;
+	MemoryBudget::Reservation memory;
+	// Для времени до ошибки в журнале
+	StageStats::Clock::time_point startTime;
+	// 0, пока исходник не хеширован
+	uint64_t contentHash = 0;
+};
+
+struct TaskResult
+{
+	ThumbnailSource source = ThumbnailSource::Decoded;
+	uint64_t contentHash = 0;
+};
+
+ThumbnailTask MakeTask(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, const std::vector<OutputSpec>& outputs);
+// Оценивает по заголовку исходника память на декодирование и масштабирование
+// и ждет ее в бюджете. JPEG, который один не помещается в бюджет,
+// декодируется с большим уменьшением, а миниатюры получаются меньше заданных
+void AdmitTask(ThumbnailTask& task, MemoryBudget& budget);
+void ReadSource(ThumbnailTask& task, const InputOptions& options, std::vector<unsigned char>* reusableBuffer = nullptr);
+// Хеш прочитанного исходника; повторный вызов ничего не пересчитывает
+uint64_t HashSource(ThumbnailTask& task);
+// Хеширует прочитанный исходник и ищет его в таблице: первая задача с таким
+// содержимым получает dedupClaim, дубликат - original и отпускает исходник
+void LookupDuplicate(ThumbnailTask& task, DedupTable& table);
+// Дубликату остается только WriteOutput, которая ссылается на миниатюры
+// оригинала; остальные стадии для него ничего не делают
+void UseOriginalOutputs(ThumbnailTask& task, DedupTable::Outputs outputs);
+void Decode(ThumbnailTask& task);
+void Resize(ThumbnailTask& task);
+void Encode(ThumbnailTask& task);
+// С pack миниатюры дописываются в пакеты вместо отдельных файлов
+void WriteOutput(ThumbnailTask& task, PackWriter* pack = nullptr);
+
 void CreateThumbnail(const std::string& inputPath, const std::string& outputPath, int targetWidth, int targetHeight);
-void ProcessTask(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, int targetWidth, int targetHeight);
+// Удаляет миниатюры исходника, который пропал из входного каталога
+void RemoveOutputs(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, const std::vector<OutputSpec>& outputs);
+TaskResult ProcessTask(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, const std::vector<OutputSpec>& outputs, const InputOptions& inputOptions = {}, DedupTable* dedupTable = nullptr, PackWriter* pack = nullptr, MemoryBudget* memoryBudget = nullptr);
+// Чтение, декодирование и масштабирование без кодирования и записи:
+// миниатюры остаются в rendition.pixels
+ThumbnailTask RenderTask(const std::string& inputPathStr, const std::string& inputDirStr, const std::string& outputDirStr, const std::vector<OutputSpec>& outputs, const InputOptions& inputOptions = {}, MemoryBudget* memoryBudget = nullptr);
+
+using DoneHandler = std::function<void(const TaskResult& result, std::exception_ptr error)>;
+// ProcessTask для задачи, исходник которой уже прочитан через AsyncIo:
+// миниатюры пишет поток ввода-вывода, из него же вызывается onDone
+void ProcessTaskAsync(ThumbnailTask task, AsyncIo& io, const DoneHandler& onDone, DedupTable* dedupTable = nullptr, MemoryBudget* memoryBudget = nullptr);
 } // namespace ImageProcessor
\ No newline at end of file
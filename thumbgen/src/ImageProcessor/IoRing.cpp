@@ -0,0 +1,236 @@
+#include "IoRing.h"
+
+#include <algorithm>
+#include <atomic>
+#include <iterator>
+#include <cerrno>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace
+{
+int SetupRing(unsigned entries, io_uring_params& params)
+{
+	return static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+}
+
+int EnterRing(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+	return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+}
+
+int RegisterRing(int fd, unsigned opcode, const void* arg, unsigned count)
+{
+	return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+}
+
+void* MapRing(int fd, size_t size, off_t offset)
+{
+	void* mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, offset);
+	if (mapping == MAP_FAILED)
+	{
+		throw std::runtime_error("Не удалось отобразить кольцо io_uring");
+	}
+	return mapping;
+}
+
+template <typename T>
+T* At(void* base, unsigned offset)
+{
+	return reinterpret_cast<T*>(static_cast<unsigned char*>(base) + offset);
+}
+
+unsigned LoadAcquire(unsigned* value)
+{
+	return std::atomic_ref(*value).load(std::memory_order_acquire);
+}
+
+void StoreRelease(unsigned* value, unsigned newValue)
+{
+	std::atomic_ref(*value).store(newValue, std::memory_order_release);
+}
+
+constexpr unsigned char REQUIRED_OPS[] = {
+	IORING_OP_OPENAT,
+	IORING_OP_STATX,
+	IORING_OP_READ,
+	IORING_OP_READ_FIXED,
+	IORING_OP_WRITE,
+	IORING_OP_CLOSE,
+};
+} // namespace
+
+IoRing::IoRing(unsigned entries)
+{
+	io_uring_params params{};
+	m_fd = SetupRing(entries, params);
+	if (m_fd < 0)
+	{
+		throw std::runtime_error("Не удалось создать кольцо io_uring");
+	}
+
+	try
+	{
+		m_sqEntries = params.sq_entries;
+		m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+		const bool isSingleMap = params.features & IORING_FEAT_SINGLE_MMAP;
+		if (isSingleMap)
+		{
+			m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+		}
+
+		m_sqRing = MapRing(m_fd, m_sqRingSize, IORING_OFF_SQ_RING);
+		m_cqRing = isSingleMap ? m_sqRing : MapRing(m_fd, m_cqRingSize, IORING_OFF_CQ_RING);
+		m_sqes = static_cast<io_uring_sqe*>(MapRing(m_fd, params.sq_entries * sizeof(io_uring_sqe), IORING_OFF_SQES));
+
+		m_sqHead = At<unsigned>(m_sqRing, params.sq_off.head);
+		m_sqTail = At<unsigned>(m_sqRing, params.sq_off.tail);
+		m_sqMask = *At<unsigned>(m_sqRing, params.sq_off.ring_mask);
+		m_cqHead = At<unsigned>(m_cqRing, params.cq_off.head);
+		m_cqTail = At<unsigned>(m_cqRing, params.cq_off.tail);
+		m_cqMask = *At<unsigned>(m_cqRing, params.cq_off.ring_mask);
+		m_cqes = At<io_uring_cqe>(m_cqRing, params.cq_off.cqes);
+
+		// SQE всегда лежат в том же порядке, что и индексы в кольце
+		unsigned* array = At<unsigned>(m_sqRing, params.sq_off.array);
+		for (unsigned i = 0; i < m_sqEntries; ++i)
+		{
+			array[i] = i;
+		}
+		m_sqeTail = m_submittedTail = *m_sqTail;
+	}
+	catch (...)
+	{
+		Release();
+		throw;
+	}
+}
+
+IoRing::~IoRing()
+{
+	Release();
+}
+
+void IoRing::Release()
+{
+	if (m_sqes)
+	{
+		munmap(m_sqes, m_sqEntries * sizeof(io_uring_sqe));
+	}
+	if (m_cqRing && m_cqRing != m_sqRing)
+	{
+		munmap(m_cqRing, m_cqRingSize);
+	}
+	if (m_sqRing)
+	{
+		munmap(m_sqRing, m_sqRingSize);
+	}
+	if (m_fd >= 0)
+	{
+		close(m_fd);
+	}
+	m_sqes = nullptr;
+	m_sqRing = m_cqRing = nullptr;
+	m_fd = -1;
+}
+
+bool IoRing::IsSupported()
+{
+	try
+	{
+		IoRing ring(2);
+		return ring.HasOps(REQUIRED_OPS, std::size(REQUIRED_OPS));
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+}
+
+bool IoRing::HasOps(const unsigned char* ops, size_t count) const
+{
+	constexpr unsigned PROBE_OPS = 256;
+	const size_t probeSize = sizeof(io_uring_probe) + PROBE_OPS * sizeof(io_uring_probe_op);
+	auto storage = std::make_unique<unsigned char[]>(probeSize);
+	auto* probe = reinterpret_cast<io_uring_probe*>(storage.get());
+	std::memset(probe, 0, probeSize);
+	if (RegisterRing(m_fd, IORING_REGISTER_PROBE, probe, PROBE_OPS) < 0)
+	{
+		return false;
+	}
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+io_uring_sqe* IoRing::GetSqe()
+{
+	if (m_sqeTail - LoadAcquire(m_sqHead) >= m_sqEntries)
+	{
+		return nullptr;
+	}
+	io_uring_sqe* sqe = &m_sqes[m_sqeTail & m_sqMask];
+	++m_sqeTail;
+	std::memset(sqe, 0, sizeof(*sqe));
+	return sqe;
+}
+
+void IoRing::Submit(unsigned waitCount)
+{
+	StoreRelease(m_sqTail, m_sqeTail);
+	const unsigned toSubmit = m_sqeTail - m_submittedTail;
+	if (toSubmit == 0 && waitCount == 0)
+	{
+		return;
+	}
+
+	while (true)
+	{
+		const int result = EnterRing(m_fd, toSubmit, waitCount, waitCount > 0 ? IORING_ENTER_GETEVENTS : 0);
+		if (result >= 0)
+		{
+			m_submittedTail += static_cast<unsigned>(result);
+			return;
+		}
+		if (errno != EINTR && errno != EAGAIN && errno != EBUSY)
+		{
+			throw std::runtime_error("Ошибка отправки запросов io_uring");
+		}
+		// Ядро занято или прервано сигналом: завершения уже могли прийти
+		if (PeekCqe())
+		{
+			return;
+		}
+	}
+}
+
+const io_uring_cqe* IoRing::PeekCqe() const
+{
+	const unsigned head = *m_cqHead;
+	if (head == LoadAcquire(m_cqTail))
+	{
+		return nullptr;
+	}
+	return &m_cqes[head & m_cqMask];
+}
+
+void IoRing::PopCqe()
+{
+	StoreRelease(m_cqHead, *m_cqHead + 1);
+}
+
+bool IoRing::RegisterBuffers(const iovec* buffers, unsigned count)
+{
+	return RegisterRing(m_fd, IORING_REGISTER_BUFFERS, buffers, count) == 0;
+}
\ No newline at end of file
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <sys/uio.h>
+
+// Минимальная обертка над кольцами io_uring через системные вызовы, без
+// liburing. Не потокобезопасна: кольцом владеет один поток.
+class IoRing
+{
+public:
+	explicit IoRing(unsigned entries);
+	~IoRing();
+
+	IoRing(const IoRing&) = delete;
+	IoRing& operator=(const IoRing&) = delete;
+
+	// Поддерживает ли ядро все операции, которые нужны AsyncIo
+	static bool IsSupported();
+
+	// Свободный обнуленный SQE или nullptr, если очередь отправки заполнена
+	io_uring_sqe* GetSqe();
+	// Отдает ядру накопленные SQE и ждет хотя бы waitCount завершений
+	void Submit(unsigned waitCount);
+	// Следующее завершение без ожидания; после обработки нужен PopCqe
+	const io_uring_cqe* PeekCqe() const;
+	void PopCqe();
+
+	bool RegisterBuffers(const iovec* buffers, unsigned count);
+
+private:
+	void Release();
+	bool HasOps(const unsigned char* ops, size_t count) const;
+
+	int m_fd = -1;
+	unsigned m_sqEntries = 0;
+	void* m_sqRing = nullptr;
+	size_t m_sqRingSize = 0;
+	void* m_cqRing = nullptr;
+	size_t m_cqRingSize = 0;
+	io_uring_sqe* m_sqes = nullptr;
+
+	unsigned* m_sqHead = nullptr;
+	unsigned* m_sqTail = nullptr;
+	unsigned m_sqMask = 0;
+	unsigned* m_cqHead = nullptr;
+	unsigned* m_cqTail = nullptr;
+	unsigned m_cqMask = 0;
+	io_uring_cqe* m_cqes = nullptr;
+
+	unsigned m_sqeTail = 0;
+	unsigned m_submittedTail = 0;
+};
\ No newline at end of file
@@ -0,0 +1,91 @@
+#include "MemoryBudget.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+
+MemoryBudget::Reservation::Reservation(MemoryBudget* budget, size_t bytes)
+	: m_budget(budget)
+	, m_bytes(bytes)
+{
+}
+
+MemoryBudget::Reservation::Reservation(Reservation&& other) noexcept
+	: m_budget(std::exchange(other.m_budget, nullptr))
+	, m_bytes(std::exchange(other.m_bytes, 0))
+{
+}
+
+MemoryBudget::Reservation& MemoryBudget::Reservation::operator=(Reservation&& other) noexcept
+{
+	if (this != &other)
+	{
+		Release();
+		m_budget = std::exchange(other.m_budget, nullptr);
+		m_bytes = std::exchange(other.m_bytes, 0);
+	}
+	return *this;
+}
+
+MemoryBudget::Reservation::~Reservation()
+{
+	Release();
+}
+
+void MemoryBudget::Reservation::Release()
+{
+	if (m_budget)
+	{
+		m_budget->Release(m_bytes);
+		m_budget = nullptr;
+		m_bytes = 0;
+	}
+}
+
+MemoryBudget::MemoryBudget(size_t limit)
+	: m_limit(limit)
+{
+	if (m_limit == 0)
+	{
+		throw std::invalid_argument("Бюджет памяти должен быть положительным");
+	}
+}
+
+size_t MemoryBudget::GetLimit() const
+{
+	return m_limit;
+}
+
+size_t MemoryBudget::GetPeakUsage() const
+{
+	std::lock_guard lock(m_mutex);
+	return m_peakUsage;
+}
+
+MemoryBudget::Reservation MemoryBudget::Acquire(size_t bytes)
+{
+	bytes = std::min(bytes, m_limit);
+
+	std::unique_lock lock(m_mutex);
+	const uint64_t ticket = m_nextTicket++;
+	m_released.wait(lock, [&] {
+		return ticket == m_servingTicket && m_used + bytes <= m_limit;
+	});
+	++m_servingTicket;
+	m_used += bytes;
+	m_peakUsage = std::max(m_peakUsage, m_used);
+	lock.unlock();
+
+	// Следующий в очереди может поместиться и без освобождения памяти
+	m_released.notify_all();
+	return {this, bytes};
+}
+
+void MemoryBudget::Release(size_t bytes)
+{
+	{
+		std::lock_guard lock(m_mutex);
+		m_used -= bytes;
+	}
+	m_released.notify_all();
+}
\ No newline at end of file
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+// Общий бюджет памяти на изображения в обработке. Задачи допускаются в
+// порядке очереди: крупная задача не голодает из-за мелких, которые
+// поместились бы раньше нее. Запрос больше всего бюджета ждет, пока
+// бюджет не освободится целиком, и идет один.
+class MemoryBudget
+{
+public:
+	class Reservation
+	{
+	public:
+		Reservation() = default;
+		Reservation(Reservation&& other) noexcept;
+		Reservation& operator=(Reservation&& other) noexcept;
+		~Reservation();
+
+		void Release();
+
+	private:
+		friend class MemoryBudget;
+		Reservation(MemoryBudget* budget, size_t bytes);
+
+		MemoryBudget* m_budget = nullptr;
+		size_t m_bytes = 0;
+	};
+
+	explicit MemoryBudget(size_t limit);
+
+	MemoryBudget(const MemoryBudget&) = delete;
+	MemoryBudget& operator=(const MemoryBudget&) = delete;
+
+	size_t GetLimit() const;
+	size_t GetPeakUsage() const;
+	Reservation Acquire(size_t bytes);
+
+private:
+	void Release(size_t bytes);
+
+	const size_t m_limit;
+	mutable std::mutex m_mutex;
+	std::condition_variable m_released;
+	size_t m_used = 0;
+	size_t m_peakUsage = 0;
+	uint64_t m_nextTicket = 0;
+	uint64_t m_servingTicket = 0;
+};
\ No newline at end of file
@@ -0,0 +1,255 @@
+#include "Progress.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace
+{
+// Вне терминала строка дописывается, а не перерисовывается: выводится реже
+constexpr int LOG_INTERVAL_MULTIPLIER = 8;
+
+// Счетчики одного потока на своей строке кэша. Пишет только поток-владелец,
+// поэтому увеличение - это чтение и запись, а не атомарное сложение
+struct alignas(64) Slot
+{
+	std::atomic<uint64_t> queuedFiles = 0;
+	std::atomic<uint64_t> queuedBytes = 0;
+	std::atomic<uint64_t> consumedBytes = 0;
+	std::atomic<uint64_t> finishedFiles = 0;
+	std::atomic<int64_t> activeDecodes = 0;
+};
+
+template <typename T>
+void Bump(std::atomic<T>& counter, T delta)
+{
+	counter.store(counter.load(std::memory_order_relaxed) + delta, std::memory_order_relaxed);
+}
+
+// Счетчики завершившихся потоков остаются в списке, чтобы суммы не убывали
+class Registry
+{
+public:
+	Slot* Add()
+	{
+		std::lock_guard lock(m_mutex);
+		m_slots.push_back(std::make_unique<Slot>());
+		return m_slots.back().get();
+	}
+
+	Progress::Totals Collect()
+	{
+		Progress::Totals totals;
+		std::lock_guard lock(m_mutex);
+		for (const auto& slot : m_slots)
+		{
+			totals.queuedFiles += slot->queuedFiles.load(std::memory_order_relaxed);
+			totals.queuedBytes += slot->queuedBytes.load(std::memory_order_relaxed);
+			totals.consumedBytes += slot->consumedBytes.load(std::memory_order_relaxed);
+			totals.finishedFiles += slot->finishedFiles.load(std::memory_order_relaxed);
+			totals.activeDecodes += slot->activeDecodes.load(std::memory_order_relaxed);
+		}
+		return totals;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<std::unique_ptr<Slot>> m_slots;
+};
+
+bool g_isEnabled = false;
+
+// Строка хода, которая сейчас стоит на терминале; пустая, если ее нет
+std::mutex g_outputMutex;
+std::string g_statusLine;
+
+Registry& GetRegistry()
+{
+	static Registry registry;
+	return registry;
+}
+
+Slot& GetThreadSlot()
+{
+	thread_local Slot* slot = GetRegistry().Add();
+	return *slot;
+}
+
+std::string FormatDuration(double seconds)
+{
+	const auto total = static_cast<long long>(seconds + 0.5);
+	char buffer[32];
+	if (total >= 3600)
+	{
+		std::snprintf(buffer, sizeof(buffer), "%lld:%02lld:%02lld", total / 3600, total / 60 % 60, total % 60);
+	}
+	else
+	{
+		std::snprintf(buffer, sizeof(buffer), "%lld:%02lld", total / 60, total % 60);
+	}
+	return buffer;
+}
+} // namespace
+
+namespace Progress
+{
+void Enable()
+{
+	g_isEnabled = true;
+}
+
+bool IsEnabled()
+{
+	return g_isEnabled;
+}
+
+void AddQueued(size_t bytes)
+{
+	if (!g_isEnabled)
+	{
+		return;
+	}
+	Slot& slot = GetThreadSlot();
+	Bump<uint64_t>(slot.queuedFiles, 1);
+	Bump<uint64_t>(slot.queuedBytes, bytes);
+}
+
+void AddConsumed(size_t bytes)
+{
+	if (g_isEnabled)
+	{
+		Bump<uint64_t>(GetThreadSlot().consumedBytes, bytes);
+	}
+}
+
+void AddFinished()
+{
+	if (g_isEnabled)
+	{
+		Bump<uint64_t>(GetThreadSlot().finishedFiles, 1);
+	}
+}
+
+DecodeScope::DecodeScope()
+	: m_isActive(g_isEnabled)
+{
+	if (m_isActive)
+	{
+		Bump<int64_t>(GetThreadSlot().activeDecodes, 1);
+	}
+}
+
+DecodeScope::~DecodeScope()
+{
+	if (m_isActive)
+	{
+		Bump<int64_t>(GetThreadSlot().activeDecodes, -1);
+	}
+}
+
+Totals Collect()
+{
+	return GetRegistry().Collect();
+}
+
+void PrintMessage(const std::string& message)
+{
+	std::lock_guard lock(g_outputMutex);
+	std::cerr << (g_statusLine.empty() ? message : "\r\033[K" + message + g_statusLine);
+}
+
+Reporter::Reporter(std::chrono::milliseconds interval)
+	: m_startTime(std::chrono::steady_clock::now())
+	, m_isTerminal(isatty(STDERR_FILENO) != 0)
+	, m_interval(m_isTerminal ? interval : interval * LOG_INTERVAL_MULTIPLIER)
+{
+	m_thread = std::thread([this] {
+		Run();
+	});
+}
+
+Reporter::~Reporter()
+{
+	Stop();
+}
+
+void Reporter::SetWalkDone()
+{
+	std::lock_guard lock(m_mutex);
+	m_isWalkDone = true;
+}
+
+void Reporter::Stop()
+{
+	if (!m_thread.joinable())
+	{
+		return;
+	}
+	{
+		std::lock_guard lock(m_mutex);
+		m_isStopping = true;
+	}
+	m_wakeup.notify_one();
+	m_thread.join();
+	Print(true);
+}
+
+void Reporter::Run()
+{
+	std::unique_lock lock(m_mutex);
+	while (!m_wakeup.wait_for(lock, m_interval, [this] {
+		return m_isStopping;
+	}))
+	{
+		lock.unlock();
+		Print(false);
+		lock.lock();
+	}
+}
+
+void Reporter::Print(bool isFinal)
+{
+	const Totals totals = Collect();
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_startTime).count();
+	const double filesPerSecond = seconds > 0 ? totals.finishedFiles / seconds : 0;
+	const double bytesPerSecond = seconds > 0 ? totals.consumedBytes / seconds : 0;
+	bool isWalkDone = false;
+	{
+		std::lock_guard lock(m_mutex);
+		isWalkDone = m_isWalkDone;
+	}
+
+	// Файлы сильно различаются по размеру, поэтому время оценивается по
+	// оставшимся байтам, а не по числу оставшихся файлов. Чтение идет с
+	// опережением, поэтому отсчет ведется от декодирования
+	std::string eta = "?";
+	if (isWalkDone && bytesPerSecond > 0)
+	{
+		const uint64_t remainingBytes = totals.queuedBytes > totals.consumedBytes ? totals.queuedBytes - totals.consumedBytes : 0;
+		eta = FormatDuration(remainingBytes / bytesPerSecond);
+	}
+
+	char line[256];
+	std::snprintf(
+		line,
+		sizeof(line),
+		"Готово %llu из %llu%s, %.1f файл/с, %.1f МБ/с, в очереди %llu, декодируется %lld, осталось %s",
+		static_cast<unsigned long long>(totals.finishedFiles),
+		static_cast<unsigned long long>(totals.queuedFiles),
+		isWalkDone ? "" : "+",
+		filesPerSecond,
+		bytesPerSecond / (1024 * 1024),
+		static_cast<unsigned long long>(totals.queuedFiles - std::min(totals.queuedFiles, totals.finishedFiles)),
+		static_cast<long long>(totals.activeDecodes),
+		eta.c_str());
+	// Строка терминала затирает хвост предыдущей, более длинной
+	std::lock_guard lock(g_outputMutex);
+	g_statusLine = m_isTerminal && !isFinal ? line : "";
+	std::cerr << (m_isTerminal ? std::string("\r") + line + "\033[K" : std::string(line)) + (m_isTerminal && !isFinal ? "" : "\n");
+}
+} // namespace Progress
\ No newline at end of file
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+// Ход обработки для вывода во время работы. Каждый поток увеличивает свои
+// счетчики обычной записью без атомарного сложения и общих строк кэша, а
+// поток вывода несколько раз в секунду суммирует их. Выключенный учет стоит
+// одной проверки флага на событие.
+namespace Progress
+{
+// Вызывается до запуска рабочих потоков
+void Enable();
+bool IsEnabled();
+
+// Файл поставлен в обработку, bytes - размер исходника
+void AddQueued(size_t bytes);
+// Исходник ушел в декодирование или оказался дубликатом: дальше его
+// обработка от размера почти не зависит
+void AddConsumed(size_t bytes);
+// Обработка файла закончилась успешно или с ошибкой
+void AddFinished();
+
+// Отмечает поток как занятый декодированием
+class DecodeScope
+{
+public:
+	DecodeScope();
+	~DecodeScope();
+
+	DecodeScope(const DecodeScope&) = delete;
+	DecodeScope& operator=(const DecodeScope&) = delete;
+
+private:
+	bool m_isActive;
+};
+
+struct Totals
+{
+	uint64_t queuedFiles = 0;
+	uint64_t queuedBytes = 0;
+	uint64_t consumedBytes = 0;
+	uint64_t finishedFiles = 0;
+	int64_t activeDecodes = 0;
+};
+
+// Сумма по потокам; значения разных потоков сняты не в один момент
+Totals Collect();
+
+// Выводит в stderr сообщение целиком, вместе с переводом строки. Строка хода,
+// которая перерисовывается на терминале, стирается перед сообщением и
+// выводится заново под ним, а не склеивается с ним
+void PrintMessage(const std::string& message);
+
+// Поток, который с заданным интервалом выводит в stderr файлы/с, МБ/с,
+// глубину очереди, число декодирований и оценку оставшегося времени по
+// байтам, которые еще не дошли до декодирования. В терминале строка
+// перерисовывается на месте
+class Reporter
+{
+public:
+	explicit Reporter(std::chrono::milliseconds interval);
+	~Reporter();
+
+	Reporter(const Reporter&) = delete;
+	Reporter& operator=(const Reporter&) = delete;
+
+	// До конца обхода общий объем неизвестен и оценки времени нет
+	void SetWalkDone();
+	// Выводит последнюю строку и останавливает поток
+	void Stop();
+
+private:
+	void Run();
+	void Print(bool isFinal);
+
+	std::chrono::steady_clock::time_point m_startTime;
+	bool m_isTerminal;
+	std::chrono::milliseconds m_interval;
+
+	std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	bool m_isWalkDone = false;
+	bool m_isStopping = false;
+	std::thread m_thread;
+};
+} // namespace Progress
\ No newline at end of file
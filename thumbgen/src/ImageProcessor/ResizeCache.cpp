@@ -0,0 +1,316 @@
+#include "ResizeCache.h"
+
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace
+{
+// Разрешений в одной галерее обычно немного; старые сэмплеры вытесняются
+constexpr size_t MAX_CACHED_SAMPLERS = 8;
+// Порог, с которого изображение делится на полосы даже посреди очереди
+constexpr long long LARGE_IMAGE_PIXELS = 16LL * 1024 * 1024;
+// В конце очереди делятся изображения не меньше этого: на мелких
+// накладные расходы на помощников больше выигрыша
+constexpr long long MIN_SPLIT_PIXELS = 1024LL * 1024;
+
+struct Geometry
+{
+	int inputWidth = 0;
+	int inputHeight = 0;
+	int outputWidth = 0;
+	int outputHeight = 0;
+	int channels = 0;
+	stbir_filter filter = STBIR_FILTER_DEFAULT;
+	int splits = 1;
+
+	bool operator==(const Geometry&) const = default;
+};
+
+// STBIR_RESIZE хранит указатель на себя (user_data), поэтому сэмплер не
+// перемещается после создания
+class Sampler
+{
+public:
+	explicit Sampler(const Geometry& geometry)
+		: m_geometry(geometry)
+	{
+		stbir_resize_init(
+			&m_resize,
+			nullptr,
+			geometry.inputWidth,
+			geometry.inputHeight,
+			0,
+			nullptr,
+			geometry.outputWidth,
+			geometry.outputHeight,
+			0,
+			static_cast<stbir_pixel_layout>(geometry.channels),
+			STBIR_TYPE_UINT8_SRGB);
+		stbir_set_filters(&m_resize, geometry.filter, geometry.filter);
+		m_splits = stbir_build_samplers_with_splits(&m_resize, geometry.splits);
+	}
+
+	~Sampler()
+	{
+		stbir_free_samplers(&m_resize);
+	}
+
+	Sampler(const Sampler&) = delete;
+	Sampler& operator=(const Sampler&) = delete;
+
+	const Geometry& GetGeometry() const
+	{
+		return m_geometry;
+	}
+
+	bool IsBuilt() const
+	{
+		return m_splits > 0;
+	}
+
+	// Полос может получиться меньше запрошенных, если изображение низкое
+	int GetSplits() const
+	{
+		return m_splits;
+	}
+
+	void SetBuffers(const unsigned char* input, unsigned char* output)
+	{
+		stbir_set_buffer_ptrs(&m_resize, input, 0, output, 0);
+	}
+
+	bool Resize()
+	{
+		return stbir_resize_extended(&m_resize) != 0;
+	}
+
+	// Полосы одного сэмплера можно масштабировать из разных потоков
+	bool ResizeSplit(int split)
+	{
+		return stbir_resize_extended_split(&m_resize, split, 1) != 0;
+	}
+
+private:
+	Geometry m_geometry;
+	STBIR_RESIZE m_resize{};
+	int m_splits = 0;
+};
+
+class SamplerCache
+{
+public:
+	// Возвращает сэмплер для геометрии, поднимая его в начало списка
+	Sampler* Get(const Geometry& geometry)
+	{
+		for (auto it = m_samplers.begin(); it != m_samplers.end(); ++it)
+		{
+			if (it->GetGeometry() == geometry)
+			{
+				m_samplers.splice(m_samplers.begin(), m_samplers, it);
+				return &m_samplers.front();
+			}
+		}
+
+		m_samplers.emplace_front(geometry);
+		if (!m_samplers.front().IsBuilt())
+		{
+			m_samplers.pop_front();
+			return nullptr;
+		}
+		if (m_samplers.size() > MAX_CACHED_SAMPLERS)
+		{
+			m_samplers.pop_back();
+		}
+		return &m_samplers.front();
+	}
+
+private:
+	std::list<Sampler> m_samplers;
+};
+
+SamplerCache& GetThreadCache()
+{
+	thread_local SamplerCache cache;
+	return cache;
+}
+
+// Сэмплер принадлежит кешу потока-владельца задания; помощники обращаются к
+// нему, только захватив полосу, а владелец ждет завершения всех захваченных
+struct SplitJob
+{
+	Sampler* sampler = nullptr;
+	int splits = 0;
+	std::atomic<int> nextSplit = 0;
+	std::atomic<int> doneSplits = 0;
+	std::atomic<bool> isFailed = false;
+};
+
+void RunSplits(SplitJob& job)
+{
+	for (int split = job.nextSplit.fetch_add(1); split < job.splits; split = job.nextSplit.fetch_add(1))
+	{
+		if (!job.sampler->ResizeSplit(split))
+		{
+			job.isFailed = true;
+		}
+		if (job.doneSplits.fetch_add(1) + 1 == job.splits)
+		{
+			job.doneSplits.notify_all();
+		}
+	}
+}
+
+void WaitSplits(SplitJob& job)
+{
+	for (int done = job.doneSplits.load(); done < job.splits; done = job.doneSplits.load())
+	{
+		job.doneSplits.wait(done);
+	}
+}
+
+class SplitBoard
+{
+public:
+	void Enable(int maxSplits, ResizeCache::HelperLauncher launcher)
+	{
+		std::lock_guard lock(m_mutex);
+		m_maxSplits = maxSplits;
+		m_launcher = std::move(launcher);
+	}
+
+	void Disable()
+	{
+		std::lock_guard lock(m_mutex);
+		m_maxSplits = 1;
+		m_launcher = nullptr;
+		m_isRunningDry = false;
+	}
+
+	void SetRunningDry(bool isRunningDry)
+	{
+		m_isRunningDry = isRunningDry;
+	}
+
+	// Сколько полос просить для изображения; 1 - делить не нужно
+	int GetSplitsFor(long long inputPixels)
+	{
+		std::lock_guard lock(m_mutex);
+		if (m_maxSplits < 2 || !m_launcher)
+		{
+			return 1;
+		}
+		const bool isLarge = inputPixels >= LARGE_IMAGE_PIXELS;
+		const bool isTail = m_isRunningDry && inputPixels >= MIN_SPLIT_PIXELS;
+		return isLarge || isTail ? m_maxSplits : 1;
+	}
+
+	void Publish(const std::shared_ptr<SplitJob>& job)
+	{
+		ResizeCache::HelperLauncher launcher;
+		{
+			std::lock_guard lock(m_mutex);
+			m_jobs.push_back(job);
+			launcher = m_launcher;
+		}
+		for (int i = 1; launcher && i < job->splits; ++i)
+		{
+			launcher(ResizeCache::HelpPendingResizes);
+		}
+	}
+
+	void Withdraw(const std::shared_ptr<SplitJob>& job)
+	{
+		std::lock_guard lock(m_mutex);
+		std::erase(m_jobs, job);
+	}
+
+	std::shared_ptr<SplitJob> FindPending()
+	{
+		std::lock_guard lock(m_mutex);
+		const auto it = std::ranges::find_if(m_jobs, [](const auto& job) {
+			return job->nextSplit.load() < job->splits;
+		});
+		return it != m_jobs.end() ? *it : nullptr;
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<std::shared_ptr<SplitJob>> m_jobs;
+	ResizeCache::HelperLauncher m_launcher;
+	int m_maxSplits = 1;
+	std::atomic<bool> m_isRunningDry = false;
+};
+
+SplitBoard& GetSplitBoard()
+{
+	static SplitBoard board;
+	return board;
+}
+
+bool ResizeInSplits(Sampler& sampler)
+{
+	auto job = std::make_shared<SplitJob>();
+	job->sampler = &sampler;
+	job->splits = sampler.GetSplits();
+
+	SplitBoard& board = GetSplitBoard();
+	board.Publish(job);
+	RunSplits(*job);
+	board.Withdraw(job);
+	WaitSplits(*job);
+	return !job->isFailed;
+}
+} // namespace
+
+namespace ResizeCache
+{
+bool Resize(
+	const unsigned char* input,
+	int inputWidth,
+	int inputHeight,
+	unsigned char* output,
+	int outputWidth,
+	int outputHeight,
+	int channels,
+	stbir_filter filter)
+{
+	const long long inputPixels = static_cast<long long>(inputWidth) * inputHeight;
+	const int splits = GetSplitBoard().GetSplitsFor(inputPixels);
+
+	Sampler* sampler = GetThreadCache().Get({inputWidth, inputHeight, outputWidth, outputHeight, channels, filter, splits});
+	if (!sampler)
+	{
+		return false;
+	}
+
+	sampler->SetBuffers(input, output);
+	return sampler->GetSplits() > 1 ? ResizeInSplits(*sampler) : sampler->Resize();
+}
+
+void EnableSplitting(int maxSplits, HelperLauncher launcher)
+{
+	GetSplitBoard().Enable(maxSplits, std::move(launcher));
+}
+
+void DisableSplitting()
+{
+	GetSplitBoard().Disable();
+}
+
+void SetRunningDry(bool isRunningDry)
+{
+	GetSplitBoard().SetRunningDry(isRunningDry);
+}
+
+void HelpPendingResizes()
+{
+	while (const auto job = GetSplitBoard().FindPending())
+	{
+		RunSplits(*job);
+	}
+}
+} // namespace ResizeCache
\ No newline at end of file
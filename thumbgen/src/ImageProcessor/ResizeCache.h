@@ -0,0 +1,35 @@
+#pragma once
+
+#include "stb_image_resize2.h"
+
+#include <functional>
+
+// Масштабирование через расширенный API stb_image_resize2. Построенные
+// сэмплеры (ядра фильтров и таблицы коэффициентов) кешируются в потоке по
+// размерам входа и выхода, числу каналов и фильтру, так что изображения
+// одинакового разрешения не строят их заново.
+//
+// Крупное изображение, а также любое изображение в конце очереди, когда
+// потокам уже нечего брать, делится на полосы (splits). Полосы забирает сам
+// поток и помощники, которых планировщик запускает на свободных потоках.
+namespace ResizeCache
+{
+using HelperLauncher = std::function<void(std::function<void()> helper)>;
+
+bool Resize(
+	const unsigned char* input,
+	int inputWidth,
+	int inputHeight,
+	unsigned char* output,
+	int outputWidth,
+	int outputHeight,
+	int channels,
+	stbir_filter filter = STBIR_FILTER_DEFAULT);
+
+void EnableSplitting(int maxSplits, HelperLauncher launcher);
+void DisableSplitting();
+void SetRunningDry(bool isRunningDry);
+
+// Забирает полосы начатых масштабирований, пока они есть
+void HelpPendingResizes();
+} // namespace ResizeCache
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "SourceFile.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+class FileDescriptor
+{
+public:
+	explicit FileDescriptor(const std::string& filePath)
+		: m_fd(open(filePath.c_str(), O_RDONLY | O_CLOEXEC))
+	{
+		if (m_fd < 0)
+		{
+			throw std::runtime_error("Не удалось открыть файл: " + filePath);
+		}
+	}
+
+	~FileDescriptor()
+	{
+		close(m_fd);
+	}
+
+	FileDescriptor(const FileDescriptor&) = delete;
+	FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+	int Get() const
+	{
+		return m_fd;
+	}
+
+private:
+	int m_fd;
+};
+
+size_t GetFileSize(int fd, const std::string& filePath)
+{
+	struct stat info{};
+	if (fstat(fd, &info) != 0)
+	{
+		throw std::runtime_error("Не удалось получить размер файла: " + filePath);
+	}
+	return static_cast<size_t>(info.st_size);
+}
+} // namespace
+
+SourceFile::SourceFile(const std::string& filePath, const InputOptions& options, std::vector<unsigned char>* reusableBuffer)
+{
+	FileDescriptor file(filePath);
+	m_size = GetFileSize(file.Get(), filePath);
+	if (m_size == 0)
+	{
+		return;
+	}
+
+	if (options.mode == InputMode::Mmap)
+	{
+		Map(file.Get(), filePath, options);
+	}
+	else
+	{
+		Read(file.Get(), filePath, options, reusableBuffer ? *reusableBuffer : m_ownBuffer);
+	}
+}
+
+SourceFile::SourceFile(const unsigned char* data, size_t size, std::function<void()> release)
+	: m_data(data)
+	, m_size(size)
+	, m_release(std::move(release))
+{
+}
+
+SourceFile::~SourceFile()
+{
+	if (m_release)
+	{
+		m_release();
+	}
+	if (m_mapping)
+	{
+		munmap(m_mapping, m_size);
+	}
+}
+
+const unsigned char* SourceFile::GetData() const
+{
+	return m_data;
+}
+
+size_t SourceFile::GetSize() const
+{
+	return m_size;
+}
+
+void SourceFile::Map(int fd, const std::string& filePath, const InputOptions& options)
+{
+	int flags = MAP_PRIVATE;
+#ifdef MAP_POPULATE
+	if (options.populate)
+	{
+		flags |= MAP_POPULATE;
+	}
+#endif
+
+	void* mapping = mmap(nullptr, m_size, PROT_READ, flags, fd, 0);
+	if (mapping == MAP_FAILED)
+	{
+		throw std::runtime_error("Не удалось отобразить файл в память: " + filePath);
+	}
+	if (options.sequential)
+	{
+		madvise(mapping, m_size, MADV_SEQUENTIAL);
+	}
+
+	m_mapping = mapping;
+	m_data = static_cast<const unsigned char*>(mapping);
+}
+
+void SourceFile::Read(int fd, const std::string& filePath, const InputOptions& options, std::vector<unsigned char>& buffer)
+{
+	if (options.sequential)
+	{
+		posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+	}
+
+	if (buffer.size() < m_size)
+	{
+		buffer.resize(m_size);
+	}
+
+	size_t offset = 0;
+	while (offset < m_size)
+	{
+		const ssize_t count = options.mode == InputMode::Pread
+			? pread(fd, buffer.data() + offset, m_size - offset, static_cast<off_t>(offset))
+			: read(fd, buffer.data() + offset, m_size - offset);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			throw std::runtime_error("Ошибка чтения файла: " + filePath);
+		}
+		offset += static_cast<size_t>(count);
+	}
+
+	m_data = buffer.data();
+}
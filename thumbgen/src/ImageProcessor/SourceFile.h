@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+enum class InputMode
+{
+	Stream,
+	Mmap,
+	Pread,
+};
+
+struct InputOptions
+{
+	InputMode mode = InputMode::Stream;
+	bool populate = false;
+	bool sequential = false;
+	// Хеш содержимого считается сразу после чтения (манифест в режиме hash)
+	bool hashContent = false;
+};
+
+// Содержимое входного файла целиком в памяти: отображение mmap либо буфер,
+// прочитанный одним вызовом. Внешний буфер позволяет потоку переиспользовать
+// одну и ту же память от файла к файлу; он должен пережить SourceFile.
+class SourceFile
+{
+public:
+	SourceFile(const std::string& filePath, const InputOptions& options, std::vector<unsigned char>* reusableBuffer = nullptr);
+	// Содержимое, уже прочитанное снаружи (AsyncIo); release освобождает
+	// его вместе с SourceFile
+	SourceFile(const unsigned char* data, size_t size, std::function<void()> release);
+	~SourceFile();
+
+	SourceFile(const SourceFile&) = delete;
+	SourceFile& operator=(const SourceFile&) = delete;
+
+	const unsigned char* GetData() const;
+	size_t GetSize() const;
+
+private:
+	void Map(int fd, const std::string& filePath, const InputOptions& options);
+	void Read(int fd, const std::string& filePath, const InputOptions& options, std::vector<unsigned char>& buffer);
+
+	std::vector<unsigned char> m_ownBuffer;
+	const unsigned char* m_data = nullptr;
+	size_t m_size = 0;
+	void* m_mapping = nullptr;
+	std::function<void()> m_release;
+};
@@ -0,0 +1,533 @@
+#include "StageStats.h"
+#include "TextUtils.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <memory>
+#include <exception>
+#include <mutex>
+#include <stdexcept>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+using StageStats::Clock;
+using StageStats::Stage;
+
+enum class Format
+{
+	Jpeg,
+	Png,
+	Other,
+};
+
+constexpr size_t STAGE_COUNT = 5;
+constexpr size_t FORMAT_COUNT = 3;
+const std::array<const char*, STAGE_COUNT> STAGE_NAMES = {"read", "decode", "resize", "encode", "write"};
+const std::array<const char*, FORMAT_COUNT> FORMAT_NAMES = {"jpeg", "png", "other"};
+
+// Логарифмические корзины по 16 на степень двойки: погрешность перцентиля
+// не больше 1/16 при постоянном размере гистограммы
+constexpr unsigned SUB_BUCKET_BITS = 4;
+constexpr uint64_t SUB_BUCKET_COUNT = 1 << SUB_BUCKET_BITS;
+constexpr size_t BUCKET_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKET_COUNT;
+
+struct FailureMark
+{
+	std::string filePath;
+	StageStats::Failure failure;
+};
+
+// Ошибки редки, поэтому путь копируется только при отметке
+thread_local std::optional<FailureMark> t_failureMark;
+
+bool g_isStatsEnabled = false;
+bool g_isTraceEnabled = false;
+size_t g_traceEventsPerThread = 0;
+Clock::time_point g_traceStartTime;
+
+size_t GetBucketIndex(uint64_t value)
+{
+	if (value < SUB_BUCKET_COUNT)
+	{
+		return static_cast<size_t>(value);
+	}
+	const unsigned shift = std::bit_width(value) - 1 - SUB_BUCKET_BITS;
+	return (shift + 1) * SUB_BUCKET_COUNT + ((value >> shift) & (SUB_BUCKET_COUNT - 1));
+}
+
+uint64_t GetBucketUpperBound(size_t index)
+{
+	if (index < SUB_BUCKET_COUNT)
+	{
+		return index;
+	}
+	const unsigned shift = static_cast<unsigned>(index / SUB_BUCKET_COUNT - 1);
+	const uint64_t lower = (SUB_BUCKET_COUNT + index % SUB_BUCKET_COUNT) << shift;
+	return lower + ((uint64_t(1) << shift) - 1);
+}
+
+struct Histogram
+{
+	std::array<uint64_t, BUCKET_COUNT> buckets{};
+	uint64_t count = 0;
+	uint64_t totalNs = 0;
+	uint64_t maxNs = 0;
+
+	void Add(uint64_t ns)
+	{
+		++buckets[GetBucketIndex(ns)];
+		++count;
+		totalNs += ns;
+		maxNs = std::max(maxNs, ns);
+	}
+
+	void Merge(const Histogram& other)
+	{
+		for (size_t i = 0; i < BUCKET_COUNT; ++i)
+		{
+			buckets[i] += other.buckets[i];
+		}
+		count += other.count;
+		totalNs += other.totalNs;
+		maxNs = std::max(maxNs, other.maxNs);
+	}
+
+	// По ближайшему рангу, с верхней границей корзины
+	uint64_t GetPercentile(double fraction) const
+	{
+		const auto rank = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(fraction * static_cast<double>(count))));
+		uint64_t seen = 0;
+		for (size_t i = 0; i < BUCKET_COUNT; ++i)
+		{
+			seen += buckets[i];
+			if (seen >= rank)
+			{
+				return std::min(GetBucketUpperBound(i), maxNs);
+			}
+		}
+		return maxNs;
+	}
+};
+
+struct Counters
+{
+	std::array<std::array<Histogram, STAGE_COUNT>, FORMAT_COUNT> histograms;
+	std::array<uint64_t, FORMAT_COUNT> sourceCounts{};
+	std::array<uint64_t, FORMAT_COUNT> bytesIn{};
+	std::array<uint64_t, FORMAT_COUNT> bytesOut{};
+
+	void Merge(const Counters& other)
+	{
+		for (size_t format = 0; format < FORMAT_COUNT; ++format)
+		{
+			for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+			{
+				histograms[format][stage].Merge(other.histograms[format][stage]);
+			}
+			sourceCounts[format] += other.sourceCounts[format];
+			bytesIn[format] += other.bytesIn[format];
+			bytesOut[format] += other.bytesOut[format];
+		}
+	}
+};
+
+// Последние события потока: после заполнения новые затирают самые старые,
+// строки путей переиспользуют выделенную под них память
+class TraceRing
+{
+public:
+	struct Event
+	{
+		Stage stage;
+		Clock::time_point startTime;
+		Clock::time_point endTime;
+		std::string filePath;
+	};
+
+	TraceRing()
+		: m_threadId(gettid())
+	{
+	}
+
+	void Add(Stage stage, const std::string& filePath, Clock::time_point startTime, Clock::time_point endTime)
+	{
+		if (m_events.size() < g_traceEventsPerThread)
+		{
+			m_events.push_back({stage, startTime, endTime, filePath});
+			return;
+		}
+		Event& event = m_events[m_next];
+		event.stage = stage;
+		event.startTime = startTime;
+		event.endTime = endTime;
+		event.filePath.assign(filePath);
+		m_next = (m_next + 1) % m_events.size();
+		++m_droppedCount;
+	}
+
+	pid_t GetThreadId() const
+	{
+		return m_threadId;
+	}
+
+	const std::vector<Event>& GetEvents() const
+	{
+		return m_events;
+	}
+
+	size_t GetDroppedCount() const
+	{
+		return m_droppedCount;
+	}
+
+private:
+	pid_t m_threadId;
+	std::vector<Event> m_events;
+	size_t m_next = 0;
+	size_t m_droppedCount = 0;
+};
+
+struct ThreadState
+{
+	Counters counters;
+	TraceRing trace;
+};
+
+class Registry
+{
+public:
+	void Add(const ThreadState* state)
+	{
+		std::lock_guard lock(m_mutex);
+		m_live.push_back(state);
+	}
+
+	void Retire(std::unique_ptr<ThreadState> state)
+	{
+		std::lock_guard lock(m_mutex);
+		m_retired.Merge(state->counters);
+		std::erase(m_live, state.get());
+		if (!state->trace.GetEvents().empty())
+		{
+			m_retiredTraces.push_back(std::move(state->trace));
+		}
+	}
+
+	std::unique_ptr<Counters> Collect()
+	{
+		auto result = std::make_unique<Counters>();
+		std::lock_guard lock(m_mutex);
+		result->Merge(m_retired);
+		for (const ThreadState* state : m_live)
+		{
+			result->Merge(state->counters);
+		}
+		return result;
+	}
+
+	template <typename Callback>
+	void ForEachTrace(const Callback& callback)
+	{
+		std::lock_guard lock(m_mutex);
+		for (const TraceRing& trace : m_retiredTraces)
+		{
+			callback(trace);
+		}
+		for (const ThreadState* state : m_live)
+		{
+			callback(state->trace);
+		}
+	}
+
+private:
+	std::mutex m_mutex;
+	std::vector<const ThreadState*> m_live;
+	Counters m_retired;
+	std::vector<TraceRing> m_retiredTraces;
+};
+
+Registry& GetRegistry()
+{
+	static Registry registry;
+	return registry;
+}
+
+// Регистрируется при первой записи потока, итог отдает при его завершении
+class ThreadStateOwner
+{
+public:
+	ThreadStateOwner()
+		: m_state(std::make_unique<ThreadState>())
+	{
+		GetRegistry().Add(m_state.get());
+	}
+
+	~ThreadStateOwner()
+	{
+		GetRegistry().Retire(std::move(m_state));
+	}
+
+	ThreadStateOwner(const ThreadStateOwner&) = delete;
+	ThreadStateOwner& operator=(const ThreadStateOwner&) = delete;
+
+	ThreadState& Get()
+	{
+		return *m_state;
+	}
+
+private:
+	std::unique_ptr<ThreadState> m_state;
+};
+
+ThreadState& GetThreadState()
+{
+	thread_local ThreadStateOwner owner;
+	return owner.Get();
+}
+
+int64_t ToUs(Clock::duration duration)
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(duration).count();
+}
+
+double ToMs(uint64_t ns)
+{
+	return static_cast<double>(ns) / 1e6;
+}
+
+void WriteHistogram(std::ostream& out, const Histogram& histogram)
+{
+	out << "{\"count\":" << histogram.count
+		<< ",\"total_ms\":" << ToMs(histogram.totalNs)
+		<< ",\"p50_ms\":" << ToMs(histogram.GetPercentile(0.50))
+		<< ",\"p95_ms\":" << ToMs(histogram.GetPercentile(0.95))
+		<< ",\"p99_ms\":" << ToMs(histogram.GetPercentile(0.99))
+		<< ",\"max_ms\":" << ToMs(histogram.maxNs) << "}";
+}
+
+void WriteStages(std::ostream& out, const std::array<Histogram, STAGE_COUNT>& stages)
+{
+	out << "{";
+	for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+	{
+		out << (stage ? "," : "") << "\"" << STAGE_NAMES[stage] << "\":";
+		WriteHistogram(out, stages[stage]);
+	}
+	out << "}";
+}
+Format GetFormat(const std::string& filePath)
+{
+	std::string extension = fs::path(filePath).extension().string();
+	std::ranges::transform(extension, extension.begin(), [](unsigned char c) {
+		return static_cast<char>(std::tolower(c));
+	});
+	if (extension == ".jpg" || extension == ".jpeg")
+	{
+		return Format::Jpeg;
+	}
+	return extension == ".png" ? Format::Png : Format::Other;
+}
+} // namespace
+
+namespace StageStats
+{
+void Enable()
+{
+	g_isStatsEnabled = true;
+}
+
+void EnableTrace(size_t eventsPerThread)
+{
+	g_traceEventsPerThread = eventsPerThread;
+	g_traceStartTime = Clock::now();
+	g_isTraceEnabled = true;
+}
+
+bool IsEnabled()
+{
+	return g_isStatsEnabled || g_isTraceEnabled;
+}
+
+void Record(Stage stage, const std::string& filePath, Clock::time_point startTime)
+{
+	const auto endTime = Clock::now();
+	ThreadState& state = GetThreadState();
+	if (g_isStatsEnabled)
+	{
+		const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(endTime - startTime).count();
+		state.counters.histograms[static_cast<size_t>(GetFormat(filePath))][static_cast<size_t>(stage)].Add(static_cast<uint64_t>(std::max<int64_t>(0, ns)));
+	}
+	if (g_isTraceEnabled)
+	{
+		state.trace.Add(stage, filePath, startTime, endTime);
+	}
+}
+
+void AddSource(const std::string& filePath, size_t bytes)
+{
+	if (!g_isStatsEnabled)
+	{
+		return;
+	}
+	const auto format = GetFormat(filePath);
+	Counters& counters = GetThreadState().counters;
+	++counters.sourceCounts[static_cast<size_t>(format)];
+	counters.bytesIn[static_cast<size_t>(format)] += bytes;
+}
+
+void AddOutput(const std::string& filePath, size_t bytes)
+{
+	if (!g_isStatsEnabled)
+	{
+		return;
+	}
+	GetThreadState().counters.bytesOut[static_cast<size_t>(GetFormat(filePath))] += bytes;
+}
+
+const char* GetStageName(Stage stage)
+{
+	return STAGE_NAMES[static_cast<size_t>(stage)];
+}
+
+void MarkFailed(Stage stage, const std::string& filePath, Clock::time_point taskStartTime)
+{
+	Failure failure{stage};
+	if (taskStartTime != Clock::time_point{})
+	{
+		failure.elapsedMs = std::chrono::duration<double, std::milli>(Clock::now() - taskStartTime).count();
+	}
+	t_failureMark = FailureMark{filePath, failure};
+}
+
+std::optional<Failure> TakeFailure(const std::string& filePath)
+{
+	if (!t_failureMark || t_failureMark->filePath != filePath)
+	{
+		return std::nullopt;
+	}
+	const Failure failure = t_failureMark->failure;
+	t_failureMark.reset();
+	return failure;
+}
+
+ScopedTimer::ScopedTimer(Stage stage, const std::string& filePath, Clock::time_point taskStartTime)
+	: m_stage(stage)
+	, m_filePath(filePath)
+	, m_taskStartTime(taskStartTime)
+	, m_uncaughtCount(std::uncaught_exceptions())
+	, m_isActive(IsEnabled())
+{
+	if (m_isActive)
+	{
+		m_startTime = Clock::now();
+	}
+}
+
+ScopedTimer::~ScopedTimer()
+{
+	if (std::uncaught_exceptions() > m_uncaughtCount)
+	{
+		MarkFailed(m_stage, m_filePath, m_taskStartTime);
+	}
+	if (m_isActive)
+	{
+		Record(m_stage, m_filePath, m_startTime);
+	}
+}
+
+void WriteReport(const std::string& filePath, const RunInfo& info)
+{
+	const auto counters = GetRegistry().Collect();
+
+	std::array<Histogram, STAGE_COUNT> totalStages;
+	uint64_t totalBytesIn = 0;
+	uint64_t totalBytesOut = 0;
+	for (size_t format = 0; format < FORMAT_COUNT; ++format)
+	{
+		for (size_t stage = 0; stage < STAGE_COUNT; ++stage)
+		{
+			totalStages[stage].Merge(counters->histograms[format][stage]);
+		}
+		totalBytesIn += counters->bytesIn[format];
+		totalBytesOut += counters->bytesOut[format];
+	}
+
+	std::ofstream out(filePath, std::ios::trunc);
+	if (!out)
+	{
+		throw std::runtime_error("Не удалось открыть файл статистики: " + filePath);
+	}
+	out << std::fixed << std::setprecision(3);
+	out << "{\"total_ms\":" << info.totalMs
+		<< ",\"processed\":" << info.processedCount
+		<< ",\"failed\":" << info.failedCount
+		<< ",\"bytes_in\":" << totalBytesIn
+		<< ",\"bytes_out\":" << totalBytesOut
+		<< ",\"stages\":";
+	WriteStages(out, totalStages);
+	out << ",\"formats\":{";
+	bool isFirst = true;
+	for (size_t format = 0; format < FORMAT_COUNT; ++format)
+	{
+		if (counters->sourceCounts[format] == 0)
+		{
+			continue;
+		}
+		out << (isFirst ? "" : ",") << "\"" << FORMAT_NAMES[format] << "\":{\"files\":" << counters->sourceCounts[format]
+			<< ",\"bytes_in\":" << counters->bytesIn[format]
+			<< ",\"bytes_out\":" << counters->bytesOut[format]
+			<< ",\"stages\":";
+		WriteStages(out, counters->histograms[format]);
+		out << "}";
+		isFirst = false;
+	}
+	out << "}}\n";
+	if (!out)
+	{
+		throw std::runtime_error("Не удалось записать файл статистики: " + filePath);
+	}
+}
+
+void WriteTrace(const std::string& filePath)
+{
+	std::ofstream out(filePath, std::ios::trunc);
+	if (!out)
+	{
+		throw std::runtime_error("Не удалось открыть файл трассировки: " + filePath);
+	}
+
+	out << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+	const pid_t processId = getpid();
+	bool isFirst = true;
+	size_t droppedCount = 0;
+	GetRegistry().ForEachTrace([&](const TraceRing& trace) {
+		out << (isFirst ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processId
+			<< ",\"tid\":" << trace.GetThreadId() << ",\"args\":{\"name\":\"thread " << trace.GetThreadId() << "\"}}";
+		isFirst = false;
+		for (const auto& event : trace.GetEvents())
+		{
+			out << ",\n{\"name\":\"" << STAGE_NAMES[static_cast<size_t>(event.stage)]
+				<< "\",\"cat\":\"stage\",\"ph\":\"X\",\"ts\":" << ToUs(event.startTime - g_traceStartTime)
+				<< ",\"dur\":" << ToUs(event.endTime - event.startTime)
+				<< ",\"pid\":" << processId << ",\"tid\":" << trace.GetThreadId()
+				<< ",\"args\":{\"file\":\"" << EscapeJson(event.filePath) << "\"}}";
+		}
+		droppedCount += trace.GetDroppedCount();
+	});
+	out << "\n],\"otherData\":{\"dropped_events\":" << droppedCount << "}}\n";
+	if (!out)
+	{
+		throw std::runtime_error("Не удалось записать файл трассировки: " + filePath);
+	}
+}
+} // namespace StageStats
\ No newline at end of file
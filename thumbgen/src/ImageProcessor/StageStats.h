@@ -0,0 +1,85 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+
+// Время стадий обработки по форматам исходников. Каждый поток пишет в свои
+// гистограммы и кольцевой буфер событий трассировки без общих атомиков; при
+// завершении потока они передаются в общий итог, а отчеты собирают итог и
+// данные живых потоков. Выключенная запись стоит одной проверки флага на стадию.
+namespace StageStats
+{
+enum class Stage
+{
+	Read,
+	Decode,
+	Resize,
+	Encode,
+	Write,
+};
+
+using Clock = std::chrono::steady_clock;
+
+// Вызываются до запуска рабочих потоков. Трассировка хранит последние
+// eventsPerThread событий каждого потока
+void Enable();
+void EnableTrace(size_t eventsPerThread);
+// Включена статистика или трассировка
+bool IsEnabled();
+
+// Стадия, начатая в startTime, закончилась сейчас. Формат определяется по
+// расширению исходника filePath
+void Record(Stage stage, const std::string& filePath, Clock::time_point startTime);
+void AddSource(const std::string& filePath, size_t bytes);
+void AddOutput(const std::string& filePath, size_t bytes);
+const char* GetStageName(Stage stage);
+
+// На какой стадии упала обработка файла. Отметку ставит ScopedTimer, из
+// которого вылетело исключение, или код, который сам ловит ошибку стадии;
+// забирает обработчик ошибки в том же потоке. elapsedMs - время от
+// taskStartTime до ошибки, отрицательное, если начало задачи неизвестно
+struct Failure
+{
+	Stage stage;
+	double elapsedMs = -1;
+};
+
+void MarkFailed(Stage stage, const std::string& filePath, Clock::time_point taskStartTime = {});
+// Отметка снимается, только если она поставлена для filePath
+std::optional<Failure> TakeFailure(const std::string& filePath);
+
+class ScopedTimer
+{
+public:
+	ScopedTimer(Stage stage, const std::string& filePath, Clock::time_point taskStartTime = {});
+	~ScopedTimer();
+
+	ScopedTimer(const ScopedTimer&) = delete;
+	ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+private:
+	Stage m_stage;
+	const std::string& m_filePath;
+	Clock::time_point m_taskStartTime;
+	int m_uncaughtCount;
+	bool m_isActive;
+	Clock::time_point m_startTime;
+};
+
+struct RunInfo
+{
+	double totalMs = 0;
+	size_t processedCount = 0;
+	size_t failedCount = 0;
+};
+
+// Перцентили, максимум, байты на входе и выходе по стадиям и форматам в JSON.
+// Вызывается, когда рабочие потоки уже остановлены
+void WriteReport(const std::string& filePath, const RunInfo& info);
+// Стадии каждого файла по потокам в формате Chrome trace event: файл
+// открывается в chrome://tracing и Perfetto
+void WriteTrace(const std::string& filePath);
+} // namespace StageStats
\ No newline at end of file
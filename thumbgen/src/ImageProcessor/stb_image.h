@@ -524,6 +524,12 @@ STBIDEF void stbi_set_unpremultiply_on_load_thread(int flag_true_if_should_unpre
 STBIDEF void stbi_convert_iphone_png_to_rgb_thread(int flag_true_if_should_convert);
 STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_flip);
 
+// decode JPEGs at 1/2, 1/4 or 1/8 scale with a reduced IDCT, picking the smallest
+// scale whose output is still at least min_width x min_height; 0,0 disables it.
+// the dimensions reported by the load functions are the scaled ones
+STBIDEF void stbi_set_jpeg_min_size(int min_width, int min_height);
+STBIDEF void stbi_set_jpeg_min_size_thread(int min_width, int min_height);
+
 // ZLIB client - used by PNG, available for other purposes
 
 STBIDEF char *stbi_zlib_decode_malloc_guesssize(const char *buffer, int len, int initial_size, int *outlen);
@@ -1134,6 +1140,31 @@ STBIDEF void stbi_set_flip_vertically_on_load_thread(int flag_true_if_should_fli
                                          : stbi__vertically_flip_on_load_global)
 #endif // STBI_THREAD_LOCAL
 
+static int stbi__jpeg_min_w_global = 0, stbi__jpeg_min_h_global = 0;
+
+STBIDEF void stbi_set_jpeg_min_size(int min_width, int min_height)
+{
+   stbi__jpeg_min_w_global = min_width;
+   stbi__jpeg_min_h_global = min_height;
+}
+
+#ifndef STBI_THREAD_LOCAL
+#define stbi__jpeg_min_w  stbi__jpeg_min_w_global
+#define stbi__jpeg_min_h  stbi__jpeg_min_h_global
+#else
+static STBI_THREAD_LOCAL int stbi__jpeg_min_w_local, stbi__jpeg_min_h_local, stbi__jpeg_min_size_set;
+
+STBIDEF void stbi_set_jpeg_min_size_thread(int min_width, int min_height)
+{
+   stbi__jpeg_min_w_local = min_width;
+   stbi__jpeg_min_h_local = min_height;
+   stbi__jpeg_min_size_set = 1;
+}
+
+#define stbi__jpeg_min_w  (stbi__jpeg_min_size_set ? stbi__jpeg_min_w_local : stbi__jpeg_min_w_global)
+#define stbi__jpeg_min_h  (stbi__jpeg_min_size_set ? stbi__jpeg_min_h_local : stbi__jpeg_min_h_global)
+#endif // STBI_THREAD_LOCAL
+
 static void *stbi__load_main(stbi__context *s, int *x, int *y, int *comp, int req_comp, stbi__result_info *ri, int bpc)
 {
    memset(ri, 0, sizeof(*ri)); // make sure it's initialized if we add new fields
@@ -1974,6 +2005,7 @@ typedef struct
       stbi_uc *linebuf;
       short   *coeff;   // progressive only
       int      coeff_w, coeff_h; // number of 8x8 coefficient blocks
+      stbi_uc  coeff_skipped[64]; // progressive only: zigzag bands skipped by a scaled decode
    } img_comp[4];
 
    stbi__uint32   code_buffer; // jpeg entropy-coded buffer
@@ -1990,6 +2022,7 @@ typedef struct
    int            jfif;
    int            app14_color_transform; // Adobe APP14 tag
    int            rgb;
+   int            scale_shift; // log2 of the reduced-IDCT downscale factor (0..3)
 
    int scan_n, order[4];
    int restart_interval, todo;
@@ -2464,6 +2497,60 @@ stbi_inline static stbi_uc stbi__clamp(int x)
    t1 += p2+p4;                                \
    t0 += p1+p3;
 
+// reduced-size IDCTs for scaled decoding: an NxN inverse transform over the
+// top-left NxN coefficients of a block yields that block downscaled by 8/N.
+// basis[x*N+u] = C(u) * cos((2x+1)*u*pi/(2N)), C(0) = 1/sqrt(2), C(u>0) = 1
+static const float stbi__idct_basis_2[4] = {
+   0.70710678f,  0.70710678f,
+   0.70710678f, -0.70710678f,
+};
+static const float stbi__idct_basis_4[16] = {
+   0.70710678f,  0.92387953f,  0.70710678f,  0.38268343f,
+   0.70710678f,  0.38268343f, -0.70710678f, -0.92387953f,
+   0.70710678f, -0.38268343f, -0.70710678f,  0.92387953f,
+   0.70710678f, -0.92387953f,  0.70710678f, -0.38268343f,
+};
+
+static void stbi__idct_reduced(stbi_uc *out, int out_stride, short data[64], const float *basis, int n)
+{
+   float tmp[16];
+   int i,j,k;
+   // rows: horizontal transform of the low-frequency coefficients
+   for (j=0; j < n; ++j) {
+      for (i=0; i < n; ++i) {
+         float t = 0;
+         for (k=0; k < n; ++k)
+            t += data[j*8+k] * basis[i*n+k];
+         tmp[j*n+i] = t;
+      }
+   }
+   // columns: vertical transform, the 1/4 normalization is the same as for 8x8
+   for (j=0; j < n; ++j, out += out_stride) {
+      for (i=0; i < n; ++i) {
+         float t = 0;
+         for (k=0; k < n; ++k)
+            t += tmp[k*n+i] * basis[j*n+k];
+         out[i] = stbi__clamp((int) (t * 0.25f + 128.5f));
+      }
+   }
+}
+
+static void stbi__idct_block_4x4(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct_basis_4, 4);
+}
+
+static void stbi__idct_block_2x2(stbi_uc *out, int out_stride, short data[64])
+{
+   stbi__idct_reduced(out, out_stride, data, stbi__idct_basis_2, 2);
+}
+
+static void stbi__idct_block_1x1(stbi_uc *out, int out_stride, short data[64])
+{
+   STBI_NOTUSED(out_stride);
+   out[0] = stbi__clamp(((data[0] + 4) >> 3) + 128);
+}
+
 static void stbi__idct_block(stbi_uc *out, int out_stride, short data[64])
 {
    int i,val[64],*v=val;
@@ -2946,6 +3033,14 @@ static void stbi__jpeg_reset(stbi__jpeg *j)
    // since we don't even allow 1<<30 pixels
 }
 
+// where the block at full-resolution pixel (x,y) of component n lands in its
+// (possibly downscaled) sample buffer
+static stbi_uc *stbi__jpeg_block_out(stbi__jpeg *z, int n, int x, int y)
+{
+   int shift = z->scale_shift;
+   return z->img_comp[n].data + (z->img_comp[n].w2 >> shift) * (y >> shift) + (x >> shift);
+}
+
 static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
 {
    stbi__jpeg_reset(z);
@@ -2964,7 +3059,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                int ha = z->img_comp[n].ha;
                if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(stbi__jpeg_block_out(z, n, i*8, j*8), z->img_comp[n].w2 >> z->scale_shift, data);
                // every data block is an MCU, so countdown the restart interval
                if (--z->todo <= 0) {
                   if (z->code_bits < 24) stbi__grow_buffer_unsafe(z);
@@ -2992,7 +3087,7 @@ static int stbi__parse_entropy_coded_data(stbi__jpeg *z)
                         int y2 = (j*z->img_comp[n].v + y)*8;
                         int ha = z->img_comp[n].ha;
                         if (!stbi__jpeg_decode_block(z, data, z->huff_dc+z->img_comp[n].hd, z->huff_ac+ha, z->fast_ac[ha], n, z->dequant[z->img_comp[n].tq])) return 0;
-                        z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*y2+x2, z->img_comp[n].w2, data);
+                        z->idct_block_kernel(stbi__jpeg_block_out(z, n, x2, y2), z->img_comp[n].w2 >> z->scale_shift, data);
                      }
                   }
                }
@@ -3089,7 +3184,7 @@ static void stbi__jpeg_finish(stbi__jpeg *z)
             for (i=0; i < w; ++i) {
                short *data = z->img_comp[n].coeff + 64 * (i + j * z->img_comp[n].coeff_w);
                stbi__jpeg_dequantize(data, z->dequant[z->img_comp[n].tq]);
-               z->idct_block_kernel(z->img_comp[n].data+z->img_comp[n].w2*j*8+i*8, z->img_comp[n].w2, data);
+               z->idct_block_kernel(stbi__jpeg_block_out(z, n, i*8, j*8), z->img_comp[n].w2 >> z->scale_shift, data);
             }
          }
       }
@@ -3318,6 +3413,18 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
    z->img_mcu_x = (s->img_x + z->img_mcu_w-1) / z->img_mcu_w;
    z->img_mcu_y = (s->img_y + z->img_mcu_h-1) / z->img_mcu_h;
 
+   // pick the smallest reduced-IDCT scale that still covers the requested size
+   z->scale_shift = 0;
+   if (stbi__jpeg_min_w > 0 && stbi__jpeg_min_h > 0) {
+      while (z->scale_shift < 3
+             && (int) (s->img_x >> (z->scale_shift+1)) >= stbi__jpeg_min_w
+             && (int) (s->img_y >> (z->scale_shift+1)) >= stbi__jpeg_min_h)
+         ++z->scale_shift;
+   }
+   if (z->scale_shift == 1) z->idct_block_kernel = stbi__idct_block_4x4;
+   if (z->scale_shift == 2) z->idct_block_kernel = stbi__idct_block_2x2;
+   if (z->scale_shift == 3) z->idct_block_kernel = stbi__idct_block_1x1;
+
    for (i=0; i < s->img_n; ++i) {
       // number of effective pixels (e.g. for non-interleaved MCU)
       z->img_comp[i].x = (s->img_x * z->img_comp[i].h + h_max-1) / h_max;
@@ -3334,7 +3441,7 @@ static int stbi__process_frame_header(stbi__jpeg *z, int scan)
       z->img_comp[i].coeff = 0;
       z->img_comp[i].raw_coeff = 0;
       z->img_comp[i].linebuf = NULL;
-      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2, z->img_comp[i].h2, 15);
+      z->img_comp[i].raw_data = stbi__malloc_mad2(z->img_comp[i].w2 >> z->scale_shift, z->img_comp[i].h2 >> z->scale_shift, 15);
       if (z->img_comp[i].raw_data == NULL)
          return stbi__free_jpeg_components(z, i+1, stbi__err("outofmem", "Out of memory"));
       // align blocks for idct using mmx/sse
@@ -3408,6 +3515,50 @@ static stbi_uc stbi__skip_jpeg_junk_at_end(stbi__jpeg *j)
    return STBI__MARKER_none;
 }
 
+static int stbi__jpeg_skip_band(stbi__jpeg *j)
+{
+   int i, k;
+   for (i=0; i < j->scan_n; ++i)
+      for (k=j->spec_start; k <= j->spec_end; ++k)
+         j->img_comp[j->order[i]].coeff_skipped[k] = 1;
+   return 0;
+}
+
+// with a scaled decode only the top-left NxN coefficients of each block reach
+// the reduced IDCT, so progressive scans whose spectral band holds none of them
+// (all AC scans at 1/8 scale) can be skipped without entropy decoding.
+// refinement scans depend on the nonzero history of every coefficient in their
+// band, so once part of a band was skipped any later scan over it is skipped
+// too; the needed coefficients then just keep fewer bits of precision
+static int stbi__jpeg_scan_needed(stbi__jpeg *j)
+{
+   int i, k, needed = 0, n = 8 >> j->scale_shift;
+   if (!j->progressive || !j->scale_shift) return 1;
+   for (k=j->spec_start; k <= j->spec_end; ++k) {
+      int pos = stbi__jpeg_dezigzag[k];
+      if ((pos >> 3) < n && (pos & 7) < n) needed = 1;
+      for (i=0; i < j->scan_n; ++i)
+         if (j->img_comp[j->order[i]].coeff_skipped[k]) return stbi__jpeg_skip_band(j);
+   }
+   return needed ? 1 : stbi__jpeg_skip_band(j);
+}
+
+// skip the entropy-coded segment of a scan, including its restart markers,
+// and return the marker that follows it
+static stbi_uc stbi__jpeg_skip_scan(stbi__jpeg *j)
+{
+   while (!stbi__at_eof(j->s)) {
+      stbi_uc x = stbi__get8(j->s);
+      while (x == 0xff) {
+         if (stbi__at_eof(j->s)) return STBI__MARKER_none;
+         x = stbi__get8(j->s);
+         if (x != 0x00 && x != 0xff && !STBI__RESTART(x))
+            return x;
+      }
+   }
+   return STBI__MARKER_none;
+}
+
 // decode image to YCbCr format
 static int stbi__decode_jpeg_image(stbi__jpeg *j)
 {
@@ -3422,7 +3573,9 @@ static int stbi__decode_jpeg_image(stbi__jpeg *j)
    while (!stbi__EOI(m)) {
       if (stbi__SOS(m)) {
          if (!stbi__process_scan_header(j)) return 0;
-         if (!stbi__parse_entropy_coded_data(j)) return 0;
+         if (!stbi__jpeg_scan_needed(j)) {
+            j->marker = stbi__jpeg_skip_scan(j);
+         } else if (!stbi__parse_entropy_coded_data(j)) return 0;
          if (j->marker == STBI__MARKER_none ) {
          j->marker = stbi__skip_jpeg_junk_at_end(j);
             // if we reach eof without hitting a marker, stbi__get_marker() below will fail and we'll eventually return 0
@@ -3873,6 +4026,20 @@ static stbi_uc *load_jpeg_image(stbi__jpeg *z, int *out_x, int *out_y, int *comp
    // load a jpeg image from whichever source, but leave in YCbCr format
    if (!stbi__decode_jpeg_image(z)) { stbi__cleanup_jpeg(z); return NULL; }
 
+   // from here on the sample buffers are all the image there is, so a scaled
+   // decode simply becomes a smaller image
+   if (z->scale_shift) {
+      int k, shift = z->scale_shift, round = (1 << shift) - 1;
+      z->s->img_x = (z->s->img_x + round) >> shift;
+      z->s->img_y = (z->s->img_y + round) >> shift;
+      for (k=0; k < z->s->img_n; ++k) {
+         z->img_comp[k].x = (z->img_comp[k].x + round) >> shift;
+         z->img_comp[k].y = (z->img_comp[k].y + round) >> shift;
+         z->img_comp[k].w2 >>= shift;
+         z->img_comp[k].h2 >>= shift;
+      }
+   }
+
    // determine actual number of components to generate
    n = req_comp ? req_comp : z->s->img_n >= 3 ? 3 : 1;
 
@@ -1,4 +1,13 @@
+#include "BufferArena.h"
+
+#define STBI_MALLOC(size) BufferArena::Allocate(size)
+#define STBI_REALLOC(ptr, newSize) BufferArena::Reallocate(ptr, newSize)
+#define STBI_FREE(ptr) BufferArena::Free(ptr)
 #define STB_IMAGE_IMPLEMENTATION
 #include "stb_image.h"
+#define STBIR_MALLOC(size, userData) ((void)(userData), BufferArena::Allocate(size))
+#define STBIR_FREE(ptr, userData) ((void)(userData), BufferArena::Free(ptr))
 #define STB_IMAGE_RESIZE_IMPLEMENTATION
-#include "stb_image_resize2.h"
\ No newline at end of file
+#include "stb_image_resize2.h"
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
\ No newline at end of file
@@ -0,0 +1,267 @@
+#include "Manifest.h"
+#include "ContentHash.h"
+#include "SourceFile.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+struct Manifest::Record
+{
+	uint64_t pathOffset;
+	uint32_t pathSize;
+	uint32_t reserved;
+	uint64_t fileSize;
+	int64_t mtime;
+	uint64_t contentHash;
+	uint64_t paramsHash;
+};
+
+namespace
+{
+constexpr char MAGIC[8] = {'T', 'G', 'M', 'A', 'N', 'I', 'F', '1'};
+
+struct Header
+{
+	char magic[8];
+	uint64_t recordCount;
+	uint64_t stringsSize;
+};
+
+int64_t GetMtime(const struct stat& info)
+{
+	return static_cast<int64_t>(info.st_mtim.tv_sec) * 1'000'000'000 + info.st_mtim.tv_nsec;
+}
+
+// Нечитаемый файл получает нулевой хеш; ошибку сообщит его обработка
+uint64_t HashFile(const std::string& filePath)
+{
+	try
+	{
+		const SourceFile file(filePath, {InputMode::Mmap, false, true});
+		return HashContent(file.GetData(), file.GetSize());
+	}
+	catch (const std::exception&)
+	{
+		return 0;
+	}
+}
+
+void WriteAll(int fd, const void* data, size_t size, const std::string& filePath)
+{
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	while (size > 0)
+	{
+		const ssize_t count = write(fd, bytes, size);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			throw std::runtime_error("Ошибка записи манифеста: " + filePath);
+		}
+		bytes += count;
+		size -= static_cast<size_t>(count);
+	}
+}
+} // namespace
+
+Manifest::Manifest(std::string filePath, uint64_t paramsHash, bool useContentHash)
+	: m_filePath(std::move(filePath))
+	, m_paramsHash(paramsHash)
+	, m_useContentHash(useContentHash)
+{
+	Load();
+}
+
+Manifest::~Manifest()
+{
+	if (m_data)
+	{
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	}
+}
+
+// Отсутствующий или поврежденный манифест - не ошибка: все файлы просто
+// считаются измененными
+void Manifest::Load()
+{
+	const int fd = open(m_filePath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		return;
+	}
+
+	struct stat info{};
+	void* mapping = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(Header))
+	{
+		mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		return;
+	}
+
+	m_data = static_cast<const unsigned char*>(mapping);
+	m_size = static_cast<size_t>(info.st_size);
+
+	Header header{};
+	std::memcpy(&header, m_data, sizeof(header));
+	const size_t recordsSize = header.recordCount * sizeof(Record);
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+		|| header.recordCount > m_size / sizeof(Record)
+		|| sizeof(Header) + recordsSize + header.stringsSize != m_size)
+	{
+		return;
+	}
+
+	m_records = reinterpret_cast<const Record*>(m_data + sizeof(Header));
+	m_recordCount = header.recordCount;
+	m_strings = reinterpret_cast<const char*>(m_data + sizeof(Header) + recordsSize);
+	m_stringsSize = header.stringsSize;
+
+	const bool isValid = std::all_of(m_records, m_records + m_recordCount, [this](const Record& record) {
+		return record.pathOffset <= m_stringsSize && record.pathSize <= m_stringsSize - record.pathOffset;
+	});
+	if (!isValid)
+	{
+		m_records = nullptr;
+		m_recordCount = 0;
+	}
+}
+
+std::string_view Manifest::GetKey(const Record& record) const
+{
+	return {m_strings + record.pathOffset, record.pathSize};
+}
+
+const Manifest::Record* Manifest::Find(const std::string& key) const
+{
+	const Record* end = m_records + m_recordCount;
+	const Record* it = std::lower_bound(m_records, end, key, [this](const Record& record, const std::string& value) {
+		return GetKey(record) < value;
+	});
+	return it != end && GetKey(*it) == key ? it : nullptr;
+}
+
+bool Manifest::IsChanged(const std::string& filePath, const std::string& inputDir)
+{
+	struct stat info{};
+	if (stat(filePath.c_str(), &info) != 0)
+	{
+		// Ошибку сообщит обработка файла
+		return true;
+	}
+
+	PendingFile file{fs::relative(filePath, inputDir).string(), {static_cast<uint64_t>(info.st_size), GetMtime(info), 0}};
+	const Record* record = Find(file.key);
+	if (record && record->paramsHash == m_paramsHash && record->fileSize == file.stamp.size)
+	{
+		bool isUnchanged = record->mtime == file.stamp.mtime;
+		// Время изменения сдвинулось (копирование, touch), но содержимое то же
+		if (!isUnchanged && m_useContentHash && record->contentHash != 0)
+		{
+			file.stamp.contentHash = HashFile(filePath);
+			isUnchanged = file.stamp.contentHash == record->contentHash;
+		}
+		if (isUnchanged)
+		{
+			file.stamp.contentHash = record->contentHash;
+			std::lock_guard lock(m_mutex);
+			m_entries.insert_or_assign(std::move(file.key), file.stamp);
+			++m_skippedCount;
+			return false;
+		}
+	}
+
+	std::lock_guard lock(m_mutex);
+	m_pending.insert_or_assign(filePath, std::move(file));
+	return true;
+}
+
+void Manifest::MarkDone(const std::string& filePath, uint64_t contentHash)
+{
+	std::lock_guard lock(m_mutex);
+	const auto it = m_pending.find(filePath);
+	if (it != m_pending.end())
+	{
+		if (contentHash != 0)
+		{
+			it->second.stamp.contentHash = contentHash;
+		}
+		m_entries.insert_or_assign(std::move(it->second.key), it->second.stamp);
+		m_pending.erase(it);
+	}
+}
+
+void Manifest::Forget(const std::string& filePath, const std::string& inputDir)
+{
+	std::lock_guard lock(m_mutex);
+	m_pending.erase(filePath);
+	m_entries.erase(fs::relative(filePath, inputDir).string());
+}
+
+void Manifest::Save()
+{
+	std::vector<Record> records;
+	records.reserve(m_entries.size());
+	std::string strings;
+	for (const auto& [key, stamp] : m_entries)
+	{
+		records.push_back({strings.size(), static_cast<uint32_t>(key.size()), 0, stamp.size, stamp.mtime, stamp.contentHash, m_paramsHash});
+		strings += key;
+	}
+
+	Header header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.recordCount = records.size();
+	header.stringsSize = strings.size();
+
+	fs::create_directories(fs::path(m_filePath).parent_path());
+	const std::string tempPath = m_filePath + ".tmp";
+	const int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		throw std::runtime_error("Не удалось создать манифест: " + tempPath);
+	}
+
+	try
+	{
+		WriteAll(fd, &header, sizeof(header), tempPath);
+		WriteAll(fd, records.data(), records.size() * sizeof(Record), tempPath);
+		WriteAll(fd, strings.data(), strings.size(), tempPath);
+		if (fsync(fd) != 0)
+		{
+			throw std::runtime_error("Ошибка записи манифеста: " + tempPath);
+		}
+	}
+	catch (...)
+	{
+		close(fd);
+		unlink(tempPath.c_str());
+		throw;
+	}
+	close(fd);
+
+	if (rename(tempPath.c_str(), m_filePath.c_str()) != 0)
+	{
+		unlink(tempPath.c_str());
+		throw std::runtime_error("Не удалось заменить манифест: " + m_filePath);
+	}
+}
+
+size_t Manifest::GetSkippedCount() const
+{
+	return m_skippedCount;
+}
\ No newline at end of file
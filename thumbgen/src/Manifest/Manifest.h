@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+struct FileStamp
+{
+	uint64_t size = 0;
+	int64_t mtime = 0;
+	uint64_t contentHash = 0;
+};
+
+// Манифест инкрементального режима: для каждого обработанного файла хранит
+// размер, время изменения, по желанию хеш содержимого и хеш параметров вывода.
+// Файл манифеста - отсортированный по пути массив записей фиксированного
+// размера и блок строк; он отображается через mmap и ищется двоичным поиском,
+// поэтому холостой запуск почти ничего не стоит сверх обхода каталога.
+// Новый манифест пишется во временный файл и подменяет старый через rename.
+class Manifest
+{
+public:
+	Manifest(std::string filePath, uint64_t paramsHash, bool useContentHash);
+	~Manifest();
+
+	Manifest(const Manifest&) = delete;
+	Manifest& operator=(const Manifest&) = delete;
+
+	// Нужно ли обработать файл; неизменный сразу переносится в новый
+	// манифест как есть. Вызывается по мере обхода каталога. Файл читается
+	// здесь, только если размер совпал, а время изменения нет: тогда хеш
+	// решает, можно ли его пропустить
+	bool IsChanged(const std::string& filePath, const std::string& inputDir);
+	// Файл обработан, его можно записать в манифест. contentHash считает
+	// рабочий поток по уже прочитанному исходнику; 0 - хеша нет
+	void MarkDone(const std::string& filePath, uint64_t contentHash = 0);
+	// Файл удален из входного каталога
+	void Forget(const std::string& filePath, const std::string& inputDir);
+	void Save();
+
+	size_t GetSkippedCount() const;
+
+private:
+	struct Record;
+
+	struct PendingFile
+	{
+		std::string key;
+		FileStamp stamp;
+	};
+
+	void Load();
+	const Record* Find(const std::string& key) const;
+	std::string_view GetKey(const Record& record) const;
+
+	std::string m_filePath;
+	uint64_t m_paramsHash;
+	bool m_useContentHash;
+
+	const unsigned char* m_data = nullptr;
+	size_t m_size = 0;
+	const Record* m_records = nullptr;
+	size_t m_recordCount = 0;
+	const char* m_strings = nullptr;
+	size_t m_stringsSize = 0;
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, PendingFile> m_pending;
+	std::map<std::string, FileStamp> m_entries;
+	size_t m_skippedCount = 0;
+};
\ No newline at end of file
@@ -0,0 +1,213 @@
+#include "PackIndex.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+struct PackIndex::Record
+{
+	uint64_t keyOffset;
+	uint32_t keySize;
+	uint32_t pack;
+	uint64_t offset;
+	uint64_t length;
+	uint32_t width;
+	uint32_t height;
+	uint64_t contentHash;
+};
+
+namespace
+{
+constexpr char MAGIC[8] = {'T', 'G', 'P', 'A', 'C', 'K', 'I', '1'};
+const std::string INDEX_FILE_NAME = "thumbs.index";
+
+struct Header
+{
+	char magic[8];
+	uint64_t recordCount;
+	uint64_t stringsSize;
+};
+
+void WriteAll(int fd, const void* data, size_t size, const std::string& filePath)
+{
+	const auto* bytes = static_cast<const unsigned char*>(data);
+	while (size > 0)
+	{
+		const ssize_t count = write(fd, bytes, size);
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			throw std::runtime_error("Ошибка записи индекса пакетов: " + filePath);
+		}
+		bytes += count;
+		size -= static_cast<size_t>(count);
+	}
+}
+} // namespace
+
+PackIndex::PackIndex(const std::string& outputDir)
+{
+	const std::string filePath = GetIndexPath(outputDir);
+	const int fd = open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+	if (fd < 0)
+	{
+		if (errno == ENOENT)
+		{
+			return;
+		}
+		throw std::runtime_error("Не удалось открыть индекс пакетов: " + filePath);
+	}
+
+	struct stat info{};
+	void* mapping = MAP_FAILED;
+	if (fstat(fd, &info) == 0 && static_cast<size_t>(info.st_size) >= sizeof(Header))
+	{
+		mapping = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	}
+	close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		throw std::runtime_error("Поврежден индекс пакетов: " + filePath);
+	}
+
+	m_data = static_cast<const unsigned char*>(mapping);
+	m_size = static_cast<size_t>(info.st_size);
+
+	Header header{};
+	std::memcpy(&header, m_data, sizeof(header));
+	const size_t recordsSize = header.recordCount * sizeof(Record);
+	if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0
+		|| header.recordCount > m_size / sizeof(Record)
+		|| sizeof(Header) + recordsSize + header.stringsSize != m_size)
+	{
+		munmap(mapping, m_size);
+		throw std::runtime_error("Поврежден индекс пакетов: " + filePath);
+	}
+
+	m_records = reinterpret_cast<const Record*>(m_data + sizeof(Header));
+	m_recordCount = header.recordCount;
+	m_strings = reinterpret_cast<const char*>(m_data + sizeof(Header) + recordsSize);
+	m_stringsSize = header.stringsSize;
+
+	const bool isValid = std::all_of(m_records, m_records + m_recordCount, [this](const Record& record) {
+		return record.keyOffset <= m_stringsSize && record.keySize <= m_stringsSize - record.keyOffset;
+	});
+	if (!isValid)
+	{
+		munmap(mapping, m_size);
+		throw std::runtime_error("Поврежден индекс пакетов: " + filePath);
+	}
+}
+
+PackIndex::~PackIndex()
+{
+	if (m_data)
+	{
+		munmap(const_cast<unsigned char*>(m_data), m_size);
+	}
+}
+
+std::string_view PackIndex::GetKey(const Record& record) const
+{
+	return {m_strings + record.keyOffset, record.keySize};
+}
+
+std::optional<PackEntry> PackIndex::Find(std::string_view key) const
+{
+	const Record* end = m_records + m_recordCount;
+	const Record* it = std::lower_bound(m_records, end, key, [this](const Record& record, std::string_view value) {
+		return GetKey(record) < value;
+	});
+	if (it == end || GetKey(*it) != key)
+	{
+		return std::nullopt;
+	}
+	return GetEntry(static_cast<size_t>(it - m_records));
+}
+
+size_t PackIndex::GetCount() const
+{
+	return m_recordCount;
+}
+
+std::string_view PackIndex::GetKey(size_t index) const
+{
+	return GetKey(m_records[index]);
+}
+
+PackEntry PackIndex::GetEntry(size_t index) const
+{
+	const Record& record = m_records[index];
+	return {record.pack, record.offset, record.length, record.width, record.height, record.contentHash};
+}
+
+std::string PackIndex::GetIndexPath(const std::string& outputDir)
+{
+	return (fs::path(outputDir) / INDEX_FILE_NAME).string();
+}
+
+std::string PackIndex::GetPackPath(const std::string& outputDir, uint32_t pack)
+{
+	return (fs::path(outputDir) / ("thumbs." + std::to_string(pack) + ".pack")).string();
+}
+
+void PackIndex::Save(const std::string& outputDir, const std::map<std::string, PackEntry>& entries)
+{
+	std::vector<Record> records;
+	records.reserve(entries.size());
+	std::string strings;
+	for (const auto& [key, entry] : entries)
+	{
+		records.push_back({strings.size(), static_cast<uint32_t>(key.size()), entry.pack, entry.offset, entry.length, entry.width, entry.height, entry.contentHash});
+		strings += key;
+	}
+
+	Header header{};
+	std::memcpy(header.magic, MAGIC, sizeof(MAGIC));
+	header.recordCount = records.size();
+	header.stringsSize = strings.size();
+
+	const std::string filePath = GetIndexPath(outputDir);
+	const std::string tempPath = filePath + ".tmp";
+	const int fd = open(tempPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (fd < 0)
+	{
+		throw std::runtime_error("Не удалось создать индекс пакетов: " + tempPath);
+	}
+
+	try
+	{
+		WriteAll(fd, &header, sizeof(header), tempPath);
+		WriteAll(fd, records.data(), records.size() * sizeof(Record), tempPath);
+		WriteAll(fd, strings.data(), strings.size(), tempPath);
+		if (fsync(fd) != 0)
+		{
+			throw std::runtime_error("Ошибка записи индекса пакетов: " + tempPath);
+		}
+	}
+	catch (...)
+	{
+		close(fd);
+		unlink(tempPath.c_str());
+		throw;
+	}
+	close(fd);
+
+	if (rename(tempPath.c_str(), filePath.c_str()) != 0)
+	{
+		unlink(tempPath.c_str());
+		throw std::runtime_error("Не удалось заменить индекс пакетов: " + filePath);
+	}
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Положение миниатюры в пакетном файле
+struct PackEntry
+{
+	uint32_t pack = 0;
+	uint64_t offset = 0;
+	uint64_t length = 0;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t contentHash = 0;
+};
+
+// Индекс пакетов миниатюр. Ключ - путь миниатюры относительно OUTPUT_DIR,
+// тот же, по которому она лежала бы отдельным файлом. Формат как у
+// манифеста: отсортированный по ключу массив записей фиксированного размера
+// и блок строк. Файл отображается через mmap и ищется двоичным поиском,
+// поэтому отдающему миниатюры процессу не нужны системные вызовы на запрос.
+class PackIndex
+{
+public:
+	// Отсутствующий индекс считается пустым, поврежденный - ошибка
+	explicit PackIndex(const std::string& outputDir);
+	~PackIndex();
+
+	PackIndex(const PackIndex&) = delete;
+	PackIndex& operator=(const PackIndex&) = delete;
+
+	std::optional<PackEntry> Find(std::string_view key) const;
+	size_t GetCount() const;
+	std::string_view GetKey(size_t index) const;
+	PackEntry GetEntry(size_t index) const;
+
+	static std::string GetIndexPath(const std::string& outputDir);
+	static std::string GetPackPath(const std::string& outputDir, uint32_t pack);
+	// Новый индекс пишется во временный файл и подменяет старый через rename
+	static void Save(const std::string& outputDir, const std::map<std::string, PackEntry>& entries);
+
+private:
+	struct Record;
+
+	std::string_view GetKey(const Record& record) const;
+
+	const unsigned char* m_data = nullptr;
+	size_t m_size = 0;
+	const Record* m_records = nullptr;
+	size_t m_recordCount = 0;
+	const char* m_strings = nullptr;
+	size_t m_stringsSize = 0;
+};
\ No newline at end of file
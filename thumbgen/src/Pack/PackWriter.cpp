@@ -0,0 +1,137 @@
+#include "PackWriter.h"
+
+#include <cerrno>
+#include <fcntl.h>
+#include <filesystem>
+#include <stdexcept>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+std::atomic<uint32_t> g_threadCount = 0;
+
+// Потоки раскладываются по пакетам по кругу в порядке первой записи
+uint32_t GetThreadNumber()
+{
+	thread_local const uint32_t threadNumber = g_threadCount++;
+	return threadNumber;
+}
+
+void WriteAt(int fd, const unsigned char* data, size_t size, uint64_t offset, const std::string& filePath)
+{
+	while (size > 0)
+	{
+		const ssize_t count = pwrite(fd, data, size, static_cast<off_t>(offset));
+		if (count < 0 && errno == EINTR)
+		{
+			continue;
+		}
+		if (count <= 0)
+		{
+			throw std::runtime_error("Ошибка записи пакета миниатюр: " + filePath);
+		}
+		data += count;
+		offset += static_cast<uint64_t>(count);
+		size -= static_cast<size_t>(count);
+	}
+}
+} // namespace
+
+PackWriter::PackWriter(std::string outputDir, uint32_t packCount, bool append)
+	: m_outputDir(fs::path(std::move(outputDir)).lexically_normal().string())
+{
+	fs::create_directories(m_outputDir);
+
+	if (append)
+	{
+		const PackIndex index(m_outputDir);
+		for (size_t i = 0; i < index.GetCount(); ++i)
+		{
+			m_entries.emplace(index.GetKey(i), index.GetEntry(i));
+		}
+	}
+
+	for (uint32_t i = 0; i < packCount; ++i)
+	{
+		auto pack = std::make_unique<Pack>();
+		const std::string packPath = PackIndex::GetPackPath(m_outputDir, i);
+		pack->fd = open(packPath.c_str(), O_RDWR | O_CREAT | O_CLOEXEC | (append ? 0 : O_TRUNC), 0644);
+		if (pack->fd < 0)
+		{
+			throw std::runtime_error("Не удалось открыть пакет миниатюр: " + packPath);
+		}
+		struct stat info{};
+		if (fstat(pack->fd, &info) != 0)
+		{
+			close(pack->fd);
+			throw std::runtime_error("Не удалось открыть пакет миниатюр: " + packPath);
+		}
+		pack->tail = static_cast<uint64_t>(info.st_size);
+		m_packs.push_back(std::move(pack));
+	}
+}
+
+PackWriter::~PackWriter()
+{
+	for (const auto& pack : m_packs)
+	{
+		close(pack->fd);
+	}
+}
+
+std::string PackWriter::GetKey(const std::string& outputPath) const
+{
+	return fs::path(outputPath).lexically_relative(m_outputDir).string();
+}
+
+void PackWriter::Append(const std::string& outputPath, const unsigned char* data, size_t size, int width, int height, uint64_t contentHash)
+{
+	const uint32_t packNumber = GetThreadNumber() % static_cast<uint32_t>(m_packs.size());
+	Pack& pack = *m_packs[packNumber];
+	const uint64_t offset = pack.tail.fetch_add(size, std::memory_order_relaxed);
+	WriteAt(pack.fd, data, size, offset, PackIndex::GetPackPath(m_outputDir, packNumber));
+
+	PackEntry entry{packNumber, offset, size, static_cast<uint32_t>(width), static_cast<uint32_t>(height), contentHash};
+	std::lock_guard lock(pack.mutex);
+	pack.entries.emplace_back(GetKey(outputPath), entry);
+}
+
+void PackWriter::Link(const std::string& originalPath, const std::string& outputPath)
+{
+	std::lock_guard lock(m_linksMutex);
+	m_links.emplace_back(GetKey(originalPath), GetKey(outputPath));
+}
+
+// Индекс пишется только после того, как данные пакетов на диске: он не
+// должен ссылаться на то, что может пропасть при сбое
+void PackWriter::Save()
+{
+	for (uint32_t i = 0; i < m_packs.size(); ++i)
+	{
+		Pack& pack = *m_packs[i];
+		if (fdatasync(pack.fd) != 0)
+		{
+			throw std::runtime_error("Ошибка записи пакета миниатюр: " + PackIndex::GetPackPath(m_outputDir, i));
+		}
+		for (auto& [key, entry] : pack.entries)
+		{
+			m_entries.insert_or_assign(std::move(key), entry);
+		}
+		pack.entries.clear();
+	}
+
+	for (const auto& [originalKey, key] : m_links)
+	{
+		const auto original = m_entries.find(originalKey);
+		if (original != m_entries.end())
+		{
+			m_entries.insert_or_assign(key, original->second);
+		}
+	}
+	m_links.clear();
+
+	PackIndex::Save(m_outputDir, m_entries);
+}
\ No newline at end of file
@@ -0,0 +1,50 @@
+#pragma once
+
+#include "PackIndex.h"
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Вывод миниатюр в несколько пакетных файлов вместо отдельного файла на
+// каждую. Место в пакете резервируется атомарным сдвигом его хвоста, а
+// данные пишутся через pwrite, так что потоки дописывают пакеты
+// одновременно без общей блокировки; каждый поток пишет в свой пакет.
+// Индекс копится в памяти и сохраняется в Save после сброса пакетов на диск.
+class PackWriter
+{
+public:
+	// append: дописывать пакеты прошлого запуска и сохранить его записи
+	// (инкрементальный режим); иначе пакеты пишутся заново
+	PackWriter(std::string outputDir, uint32_t packCount, bool append);
+	~PackWriter();
+
+	PackWriter(const PackWriter&) = delete;
+	PackWriter& operator=(const PackWriter&) = delete;
+
+	void Append(const std::string& outputPath, const unsigned char* data, size_t size, int width, int height, uint64_t contentHash);
+	// Дубликат получает ту же запись, что и миниатюра оригинала
+	void Link(const std::string& originalPath, const std::string& outputPath);
+	void Save();
+
+private:
+	struct Pack
+	{
+		int fd = -1;
+		std::atomic<uint64_t> tail = 0;
+		std::mutex mutex;
+		std::vector<std::pair<std::string, PackEntry>> entries;
+	};
+
+	std::string GetKey(const std::string& outputPath) const;
+
+	std::string m_outputDir;
+	std::vector<std::unique_ptr<Pack>> m_packs;
+	std::map<std::string, PackEntry> m_entries;
+	std::mutex m_linksMutex;
+	std::vector<std::pair<std::string, std::string>> m_links;
+};
\ No newline at end of file
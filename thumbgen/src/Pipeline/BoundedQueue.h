@@ -0,0 +1,154 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <memory>
+#include <optional>
+
+// Ограниченная MPMC-очередь без блокировок (кольцевой буфер Вьюкова):
+// каждая ячейка хранит номер хода, по которому производители и потребители
+// захватывают ее одним CAS. Ожидание на пустой/полной очереди - через
+// atomic::wait, чтобы простаивающая стадия не жгла процессор.
+template <typename T>
+class BoundedQueue
+{
+public:
+	explicit BoundedQueue(size_t capacity)
+		: m_capacity(std::bit_ceil(std::max<size_t>(capacity, 2)))
+		, m_mask(m_capacity - 1)
+		, m_cells(std::make_unique<Cell[]>(m_capacity))
+	{
+		for (size_t i = 0; i < m_capacity; ++i)
+		{
+			m_cells[i].sequence.store(i, std::memory_order_relaxed);
+		}
+	}
+
+	BoundedQueue(const BoundedQueue&) = delete;
+	BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+	bool TryPush(T& value)
+	{
+		size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[pos & m_mask];
+			const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+			if (diff == 0)
+			{
+				if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					cell.value = std::move(value);
+					cell.sequence.store(pos + 1, std::memory_order_release);
+					Notify(m_pushCount);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_enqueuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	bool TryPop(T& value)
+	{
+		size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+		for (;;)
+		{
+			Cell& cell = m_cells[pos & m_mask];
+			const size_t sequence = cell.sequence.load(std::memory_order_acquire);
+			const auto diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos + 1);
+			if (diff == 0)
+			{
+				if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+				{
+					value = std::move(cell.value);
+					cell.sequence.store(pos + m_capacity, std::memory_order_release);
+					Notify(m_popCount);
+					return true;
+				}
+			}
+			else if (diff < 0)
+			{
+				return false;
+			}
+			else
+			{
+				pos = m_dequeuePos.load(std::memory_order_relaxed);
+			}
+		}
+	}
+
+	void Push(T value)
+	{
+		for (;;)
+		{
+			const uint32_t seen = m_popCount.load(std::memory_order_acquire);
+			if (TryPush(value))
+			{
+				return;
+			}
+			m_popCount.wait(seen, std::memory_order_acquire);
+		}
+	}
+
+	// Возвращает nullopt, когда очередь закрыта и опустела
+	std::optional<T> Pop()
+	{
+		T value;
+		for (;;)
+		{
+			const uint32_t seen = m_pushCount.load(std::memory_order_acquire);
+			if (TryPop(value))
+			{
+				return value;
+			}
+			if (m_closed.load(std::memory_order_acquire))
+			{
+				return TryPop(value) ? std::optional<T>(std::move(value)) : std::nullopt;
+			}
+			m_pushCount.wait(seen, std::memory_order_acquire);
+		}
+	}
+
+	void Close()
+	{
+		m_closed.store(true, std::memory_order_release);
+		Notify(m_pushCount);
+	}
+
+	size_t Capacity() const
+	{
+		return m_capacity;
+	}
+
+private:
+	struct Cell
+	{
+		std::atomic<size_t> sequence;
+		T value;
+	};
+
+	static void Notify(std::atomic<uint32_t>& counter)
+	{
+		counter.fetch_add(1, std::memory_order_release);
+		counter.notify_all();
+	}
+
+	const size_t m_capacity;
+	const size_t m_mask;
+	std::unique_ptr<Cell[]> m_cells;
+	alignas(64) std::atomic<size_t> m_enqueuePos = 0;
+	alignas(64) std::atomic<size_t> m_dequeuePos = 0;
+	alignas(64) std::atomic<uint32_t> m_pushCount = 0;
+	alignas(64) std::atomic<uint32_t> m_popCount = 0;
+	std::atomic<bool> m_closed = false;
+};
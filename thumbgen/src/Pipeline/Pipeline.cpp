@@ -0,0 +1,197 @@
+#include "Pipeline.h"
+#include "BoundedQueue.h"
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <stdexcept>
+#include <thread>
+
+namespace
+{
+using ImageProcessor::ThumbnailTask;
+using TaskQueue = BoundedQueue<ThumbnailTask>;
+
+// Возвращает false, если задача отложена и дальше по конвейеру не идет
+using StageAction = std::function<bool(ThumbnailTask&)>;
+
+struct Stage
+{
+	StageAction action;
+	size_t numThreads = 1;
+	TaskQueue* input = nullptr;
+	TaskQueue* output = nullptr;
+	std::atomic<size_t> activeWorkers = 0;
+};
+
+void RunStageWorker(Stage& stage, const Pipeline::DoneHandler& onDone, const Pipeline::ErrorHandler& onError)
+{
+	while (auto task = stage.input->Pop())
+	{
+		try
+		{
+			if (!stage.action(*task))
+			{
+				continue;
+			}
+		}
+		catch (const std::exception& e)
+		{
+			onError(task->inputPath, e);
+			continue;
+		}
+
+		if (stage.output)
+		{
+			stage.output->Push(std::move(*task));
+		}
+		else
+		{
+			onDone(*task);
+		}
+	}
+
+	if (stage.activeWorkers.fetch_sub(1) == 1 && stage.output)
+	{
+		stage.output->Close();
+	}
+}
+
+StageAction Forward(void (*action)(ThumbnailTask&))
+{
+	return [action](ThumbnailTask& task) {
+		action(task);
+		return true;
+	};
+}
+
+// Дубликат еще не готового оригинала не ждет его в потоке стадии (он обогнал
+// бы оригинал и занял поток, через который тому еще идти), а откладывается:
+// ссылки на миниатюры создаст поток записи оригинала при публикации
+bool DeferDuplicate(ThumbnailTask& task, PackWriter* pack, const Pipeline::DoneHandler& onDone, const Pipeline::ErrorHandler& onError)
+{
+	auto deferred = std::make_shared<ThumbnailTask>(std::move(task));
+	const bool isDeferred = deferred->original->Defer([deferred, pack, &onDone, &onError](const DedupTable::Outputs& outputs) {
+		try
+		{
+			ImageProcessor::UseOriginalOutputs(*deferred, outputs);
+			ImageProcessor::WriteOutput(*deferred, pack);
+			onDone(*deferred);
+		}
+		catch (const std::exception& e)
+		{
+			onError(deferred->inputPath, e);
+		}
+	});
+
+	if (!isDeferred)
+	{
+		task = std::move(*deferred);
+		ImageProcessor::UseOriginalOutputs(task, task.original->Wait());
+	}
+	return !isDeferred;
+}
+
+void AssertIsStageThreadsValid(const PipelineConfig& config)
+{
+	if (config.readThreads < 1 || config.decodeThreads < 1 || config.resizeThreads < 1
+		|| config.encodeThreads < 1 || config.writeThreads < 1)
+	{
+		throw std::invalid_argument("Каждой стадии конвейера нужен хотя бы один поток");
+	}
+}
+} // namespace
+
+Pipeline::Pipeline(const PipelineConfig& config, std::vector<ImageProcessor::OutputSpec> outputs)
+	: m_config(config)
+	, m_outputs(std::move(outputs))
+{
+	AssertIsStageThreadsValid(m_config);
+}
+
+void Pipeline::Run(
+	const FileSource& source,
+	const std::string& inputDir,
+	const std::string& outputDir,
+	const DoneHandler& onDone,
+	const ErrorHandler& onError)
+{
+	std::array<TaskQueue, 5> queues{
+		TaskQueue(m_config.queueCapacity),
+		TaskQueue(m_config.queueCapacity),
+		TaskQueue(m_config.queueCapacity),
+		TaskQueue(m_config.queueCapacity),
+		TaskQueue(m_config.queueCapacity)};
+
+	std::array<Stage, 5> stages;
+	stages[0].action = [this, &onDone, &onError](ThumbnailTask& task) {
+		// Бюджет занимается до чтения и держится, пока задача не пройдет все
+		// стадии, так что ждут памяти только потоки чтения
+		if (m_config.memoryBudget)
+		{
+			ImageProcessor::AdmitTask(task, *m_config.memoryBudget);
+		}
+		ImageProcessor::ReadSource(task, m_config.input);
+		if (m_config.dedupTable)
+		{
+			ImageProcessor::LookupDuplicate(task, *m_config.dedupTable);
+			if (task.original)
+			{
+				return DeferDuplicate(task, m_config.packWriter, onDone, onError);
+			}
+		}
+		return true;
+	};
+	stages[0].numThreads = m_config.readThreads;
+	stages[1].action = Forward(ImageProcessor::Decode);
+	stages[1].numThreads = m_config.decodeThreads;
+	stages[2].action = Forward(ImageProcessor::Resize);
+	stages[2].numThreads = m_config.resizeThreads;
+	stages[3].action = Forward(ImageProcessor::Encode);
+	stages[3].numThreads = m_config.encodeThreads;
+	stages[4].action = [this](ThumbnailTask& task) {
+		ImageProcessor::WriteOutput(task, m_config.packWriter);
+		return true;
+	};
+	stages[4].numThreads = m_config.writeThreads;
+
+	for (size_t i = 0; i < stages.size(); ++i)
+	{
+		stages[i].input = &queues[i];
+		stages[i].output = i + 1 < stages.size() ? &queues[i + 1] : nullptr;
+		stages[i].activeWorkers = stages[i].numThreads;
+	}
+
+	{
+		std::vector<std::jthread> workers;
+		for (auto& stage : stages)
+		{
+			for (size_t i = 0; i < stage.numThreads; ++i)
+			{
+				workers.emplace_back(RunStageWorker, std::ref(stage), std::cref(onDone), std::cref(onError));
+			}
+		}
+
+		// Если обход упал, очередь все равно закрывается, иначе потоки стадий
+		// не завершатся и деструкторы jthread будут ждать их вечно
+		try
+		{
+			source([&](const std::string& filePath) {
+				try
+				{
+					queues[0].Push(ImageProcessor::MakeTask(filePath, inputDir, outputDir, m_outputs));
+				}
+				catch (const std::exception& e)
+				{
+					onError(filePath, e);
+				}
+			});
+		}
+		catch (...)
+		{
+			queues[0].Close();
+			throw;
+		}
+		queues[0].Close();
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "ImageProcessor.h"
+
+#include <exception>
+#include <functional>
+#include <string>
+#include <vector>
+
+struct PipelineConfig
+{
+	size_t readThreads = 1;
+	size_t decodeThreads = 1;
+	size_t resizeThreads = 1;
+	size_t encodeThreads = 1;
+	size_t writeThreads = 1;
+	size_t queueCapacity = 8;
+	InputOptions input;
+	DedupTable* dedupTable = nullptr;
+	PackWriter* packWriter = nullptr;
+	MemoryBudget* memoryBudget = nullptr;
+};
+
+// Чтение -> декодирование -> масштабирование -> кодирование -> запись.
+// Стадии связаны ограниченными очередями, у каждой свой набор потоков,
+// так что ожидающий диска поток не занимает место вычислительного.
+class Pipeline
+{
+public:
+	using DoneHandler = std::function<void(const ImageProcessor::ThumbnailTask& task)>;
+	using ErrorHandler = std::function<void(const std::string& filePath, const std::exception& e)>;
+	// Источник файлов вызывает submit для каждого найденного файла; submit
+	// блокируется, пока первая очередь заполнена
+	using FileSource = std::function<void(const std::function<void(const std::string& filePath)>& submit)>;
+
+	Pipeline(const PipelineConfig& config, std::vector<ImageProcessor::OutputSpec> outputs);
+
+	void Run(
+		const FileSource& source,
+		const std::string& inputDir,
+		const std::string& outputDir,
+		const DoneHandler& onDone,
+		const ErrorHandler& onError);
+
+private:
+	PipelineConfig m_config;
+	std::vector<ImageProcessor::OutputSpec> m_outputs;
+};
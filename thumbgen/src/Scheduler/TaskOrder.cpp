@@ -0,0 +1,42 @@
+#include "TaskOrder.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <utility>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+void SubmitInOrder(TaskOrder order, const FileSource& source, const FileHandler& submit)
+{
+	if (order == TaskOrder::Directory)
+	{
+		source(submit);
+		return;
+	}
+
+	// Файл, который не удалось измерить, ставится как пустой: ошибку
+	// покажет его обработка
+	std::vector<std::pair<uintmax_t, std::string>> files;
+	source([&files](const std::string& filePath) {
+		std::error_code error;
+		const uintmax_t size = fs::file_size(filePath, error);
+		files.emplace_back(error ? 0 : size, filePath);
+	});
+
+	if (order == TaskOrder::LargestFirst)
+	{
+		std::ranges::sort(files, [](const auto& lhs, const auto& rhs) {
+			return lhs.first != rhs.first ? lhs.first > rhs.first : lhs.second < rhs.second;
+		});
+	}
+	else
+	{
+		std::ranges::sort(files);
+	}
+	for (const auto& [size, filePath] : files)
+	{
+		submit(filePath);
+	}
+}
\ No newline at end of file
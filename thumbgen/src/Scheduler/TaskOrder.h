@@ -0,0 +1,22 @@
+#pragma once
+
+#include <functional>
+#include <string>
+
+enum class TaskOrder
+{
+	// Как отдает обход: соседние файлы обрабатываются вместе
+	Directory,
+	// Крупные первыми (LPT): самый долгий файл не остается на конец
+	LargestFirst,
+	// Мелкие первыми: первые миниатюры появляются раньше
+	SmallestFirst,
+};
+
+using FileHandler = std::function<void(const std::string& filePath)>;
+using FileSource = std::function<void(const FileHandler& onFile)>;
+
+// Directory передает файлы по мере обхода. Остальным порядкам нужен весь
+// список: файлы накапливаются до конца обхода с размером из stat и только
+// потом передаются отсортированными
+void SubmitInOrder(TaskOrder order, const FileSource& source, const FileHandler& submit);
\ No newline at end of file
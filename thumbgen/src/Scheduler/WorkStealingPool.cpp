@@ -0,0 +1,136 @@
+#include "WorkStealingPool.h"
+
+namespace
+{
+// Пул, которому принадлежит текущий поток, и номер потока в нем
+thread_local const void* t_pool = nullptr;
+thread_local size_t t_workerIndex = 0;
+} // namespace
+
+WorkStealingPool::WorkStealingPool(size_t numThreads, ThreadStartHandler onThreadStart)
+{
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		m_workers.push_back(std::make_unique<Worker>());
+	}
+	for (size_t i = 0; i < numThreads; ++i)
+	{
+		m_threads.emplace_back([this, i, onThreadStart] {
+			Run(i, onThreadStart);
+		});
+	}
+}
+
+WorkStealingPool::~WorkStealingPool()
+{
+	Join();
+}
+
+void WorkStealingPool::Post(Task task)
+{
+	// Счетчик растет раньше, чем задача попадает в деку, и не уходит в минус
+	// у успевшего ее забрать потока
+	m_queuedCount.fetch_add(1);
+
+	// Задача рабочего потока обычно продолжает или помогает его текущей
+	// работе: она идет в начало своей деки и первой достается ворам
+	if (t_pool == this)
+	{
+		Worker& worker = *m_workers[t_workerIndex];
+		std::lock_guard lock(worker.mutex);
+		worker.tasks.push_front(std::move(task));
+	}
+	else
+	{
+		Worker& worker = *m_workers[m_nextWorker.fetch_add(1, std::memory_order_relaxed) % m_workers.size()];
+		std::lock_guard lock(worker.mutex);
+		worker.tasks.push_back(std::move(task));
+	}
+
+	// Засыпающий поток сначала отмечается, а потом проверяет счетчик, поэтому
+	// либо он увидит задачу, либо здесь будет виден он. Захват мьютекса
+	// дожидается, пока он действительно уснет
+	if (m_sleepingCount.load() > 0)
+	{
+		{
+			std::lock_guard lock(m_mutex);
+		}
+		m_wakeup.notify_one();
+	}
+}
+
+void WorkStealingPool::Join()
+{
+	m_isStopping = true;
+	{
+		std::lock_guard lock(m_mutex);
+	}
+	m_wakeup.notify_all();
+	for (auto& thread : m_threads)
+	{
+		if (thread.joinable())
+		{
+			thread.join();
+		}
+	}
+}
+
+size_t WorkStealingPool::GetStolenCount() const
+{
+	return m_stolenCount.load(std::memory_order_relaxed);
+}
+
+void WorkStealingPool::Run(size_t workerIndex, const ThreadStartHandler& onThreadStart)
+{
+	t_pool = this;
+	t_workerIndex = workerIndex;
+	if (onThreadStart)
+	{
+		onThreadStart(workerIndex);
+	}
+
+	while (true)
+	{
+		Task task;
+		if (TryTake(workerIndex, task))
+		{
+			m_queuedCount.fetch_sub(1, std::memory_order_relaxed);
+			task();
+			continue;
+		}
+
+		// Пока задача учтена, но еще не положена в деку или уже забрана, но
+		// еще не вычтена, ожидание сразу возвращается и деки просматриваются
+		// снова
+		std::unique_lock lock(m_mutex);
+		m_sleepingCount.fetch_add(1);
+		m_wakeup.wait(lock, [this] {
+			return m_queuedCount.load() > 0 || m_isStopping;
+		});
+		m_sleepingCount.fetch_sub(1, std::memory_order_relaxed);
+		if (m_queuedCount.load() == 0 && m_isStopping)
+		{
+			return;
+		}
+	}
+}
+
+bool WorkStealingPool::TryTake(size_t workerIndex, Task& task)
+{
+	for (size_t i = 0; i < m_workers.size(); ++i)
+	{
+		Worker& worker = *m_workers[(workerIndex + i) % m_workers.size()];
+		std::lock_guard lock(worker.mutex);
+		if (!worker.tasks.empty())
+		{
+			task = std::move(worker.tasks.front());
+			worker.tasks.pop_front();
+			if (i > 0)
+			{
+				m_stolenCount.fetch_add(1, std::memory_order_relaxed);
+			}
+			return true;
+		}
+	}
+	return false;
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <atomic>
+#include <concepts>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Пул потоков с декой задач у каждого потока. Задачи извне раскладываются по
+// декам по кругу, задачи из рабочего потока кладутся в начало его деки.
+// Поток берет задачи из начала своей деки, а когда она пуста - крадет из
+// начала чужих, так что порядок подачи в целом сохраняется, а хвост
+// не простаивает за одним занятым потоком.
+class WorkStealingPool
+{
+public:
+	// Как std::function<void()>, но принимает и некопируемые функторы:
+	// задачи чтения несут с собой прочитанный файл
+	class Task
+	{
+	public:
+		Task() = default;
+
+		template <typename Function>
+			requires(!std::same_as<std::decay_t<Function>, Task>)
+		Task(Function&& function)
+			: m_callable(std::make_unique<Callable<std::decay_t<Function>>>(std::forward<Function>(function)))
+		{
+		}
+
+		void operator()()
+		{
+			m_callable->Call();
+		}
+
+	private:
+		struct CallableBase
+		{
+			virtual ~CallableBase() = default;
+			virtual void Call() = 0;
+		};
+
+		template <typename Function>
+		struct Callable : CallableBase
+		{
+			explicit Callable(Function&& function)
+				: function(std::move(function))
+			{
+			}
+
+			explicit Callable(const Function& function)
+				: function(function)
+			{
+			}
+
+			void Call() override
+			{
+				function();
+			}
+
+			Function function;
+		};
+
+		std::unique_ptr<CallableBase> m_callable;
+	};
+
+	// Вызывается в каждом рабочем потоке до первой задачи
+	using ThreadStartHandler = std::function<void(size_t workerIndex)>;
+
+	explicit WorkStealingPool(size_t numThreads, ThreadStartHandler onThreadStart = {});
+	~WorkStealingPool();
+
+	WorkStealingPool(const WorkStealingPool&) = delete;
+	WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+	void Post(Task task);
+	// Ждет, пока выполнятся все задачи, в том числе поставленные самими
+	// задачами, и останавливает потоки. Извне после Join задачи не ставятся
+	void Join();
+	size_t GetStolenCount() const;
+
+private:
+	struct Worker
+	{
+		std::mutex mutex;
+		std::deque<Task> tasks;
+	};
+
+	void Run(size_t workerIndex, const ThreadStartHandler& onThreadStart);
+	bool TryTake(size_t workerIndex, Task& task);
+
+	std::vector<std::unique_ptr<Worker>> m_workers;
+	std::atomic<size_t> m_nextWorker = 0;
+	std::atomic<size_t> m_stolenCount = 0;
+
+	// Счетчик задач в деках меняется без блокировки; мьютекс и условная
+	// переменная нужны только чтобы усыпить простаивающий поток
+	std::atomic<size_t> m_queuedCount = 0;
+	std::atomic<size_t> m_sleepingCount = 0;
+	std::atomic<bool> m_isStopping = false;
+	std::mutex m_mutex;
+	std::condition_variable m_wakeup;
+	std::vector<std::thread> m_threads;
+};
\ No newline at end of file
@@ -0,0 +1,36 @@
+#include "TextUtils.h"
+
+#include <cstdio>
+
+std::string ReplaceAll(std::string str, const std::string& from, const std::string& to)
+{
+	for (size_t pos = str.find(from); pos != std::string::npos; pos = str.find(from, pos + to.size()))
+	{
+		str.replace(pos, from.size(), to);
+	}
+	return str;
+}
+
+std::string EscapeJson(const std::string& value)
+{
+	std::string result;
+	for (const char c : value)
+	{
+		if (c == '"' || c == '\\')
+		{
+			result += '\\';
+			result += c;
+		}
+		else if (static_cast<unsigned char>(c) < 0x20)
+		{
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			result += escaped;
+		}
+		else
+		{
+			result += c;
+		}
+	}
+	return result;
+}
\ No newline at end of file
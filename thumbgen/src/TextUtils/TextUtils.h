@@ -0,0 +1,8 @@
+#pragma once
+
+#include <string>
+
+// Заменяет все вхождения from; замена повторно не просматривается
+std::string ReplaceAll(std::string str, const std::string& from, const std::string& to);
+// Экранирует строку для вставки в JSON между кавычками
+std::string EscapeJson(const std::string& value);
\ No newline at end of file
@@ -0,0 +1,239 @@
+#include "DirectoryWatcher.h"
+
+#include <cerrno>
+#include <filesystem>
+#include <poll.h>
+#include <stdexcept>
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace
+{
+constexpr uint32_t WATCH_MASK = IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_CREATE | IN_ONLYDIR;
+constexpr size_t EVENTS_BUFFER_SIZE = 64 * 1024;
+// Как часто проверяется запрос на остановку, пока событий нет
+constexpr int POLL_TIMEOUT_MS = 200;
+
+std::string JoinPath(const std::string& dirPath, const char* name)
+{
+	return (fs::path(dirPath) / name).string();
+}
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher(const std::string& dirPath, const std::unordered_set<std::string>& extensions)
+	: m_fd(inotify_init1(IN_NONBLOCK | IN_CLOEXEC))
+	, m_dirPath(dirPath)
+	, m_extensions(extensions)
+{
+	if (m_fd < 0)
+	{
+		throw std::runtime_error("Не удалось запустить inotify");
+	}
+
+	try
+	{
+		AddWatchTree(dirPath);
+	}
+	catch (...)
+	{
+		close(m_fd);
+		throw;
+	}
+}
+
+DirectoryWatcher::~DirectoryWatcher()
+{
+	close(m_fd);
+}
+
+int DirectoryWatcher::AddWatch(const std::string& dirPath)
+{
+	const int wd = inotify_add_watch(m_fd, dirPath.c_str(), WATCH_MASK);
+	if (wd < 0)
+	{
+		// Каталог успели удалить - следить не за чем
+		if (errno == ENOENT || errno == ENOTDIR)
+		{
+			return wd;
+		}
+		throw std::runtime_error("Не удалось подписаться на изменения каталога " + dirPath + " (см. fs.inotify.max_user_watches)");
+	}
+	// Повторная подписка на тот же каталог возвращает прежний wd: известные
+	// файлы сохраняются
+	m_dirs[wd].path = dirPath;
+	return wd;
+}
+
+void DirectoryWatcher::AddWatchTree(const std::string& dirPath)
+{
+	std::unordered_map<std::string, int> wds;
+	wds[dirPath] = AddWatch(dirPath);
+
+	std::error_code error;
+	for (fs::recursive_directory_iterator it(dirPath, error), end; !error && it != end; it.increment(error))
+	{
+		if (it->is_directory(error) && !it->is_symlink(error))
+		{
+			wds[it->path().string()] = AddWatch(it->path().string());
+		}
+		else if (it->is_regular_file(error) && IsWanted(it->path().string()))
+		{
+			const auto wd = wds.find(it->path().parent_path().string());
+			if (wd != wds.end() && wd->second >= 0)
+			{
+				m_dirs[wd->second].files.insert(it->path().filename().string());
+			}
+		}
+	}
+}
+
+void DirectoryWatcher::RemoveWatchTree(const std::string& dirPath, const FileHandler& onRemoved)
+{
+	const std::string prefix = dirPath + "/";
+	for (auto it = m_dirs.begin(); it != m_dirs.end();)
+	{
+		const std::string& path = it->second.path;
+		if (path != dirPath && path.compare(0, prefix.size(), prefix) != 0)
+		{
+			++it;
+			continue;
+		}
+		for (const auto& name : it->second.files)
+		{
+			onRemoved(JoinPath(path, name.c_str()));
+		}
+		// Перенесенный каталог продолжает слать события под старым путем,
+		// пока с него не снята подписка
+		inotify_rm_watch(m_fd, it->first);
+		it = m_dirs.erase(it);
+	}
+}
+
+void DirectoryWatcher::ReconcileRemoved(const FileHandler& onRemoved)
+{
+	std::vector<std::string> removedDirs;
+	for (auto& [wd, dir] : m_dirs)
+	{
+		std::error_code error;
+		if (!fs::is_directory(dir.path, error))
+		{
+			removedDirs.push_back(dir.path);
+			continue;
+		}
+		for (auto it = dir.files.begin(); it != dir.files.end();)
+		{
+			const std::string path = JoinPath(dir.path, it->c_str());
+			if (fs::exists(path, error))
+			{
+				++it;
+				continue;
+			}
+			onRemoved(path);
+			it = dir.files.erase(it);
+		}
+	}
+	for (const auto& dirPath : removedDirs)
+	{
+		RemoveWatchTree(dirPath, onRemoved);
+	}
+}
+
+bool DirectoryWatcher::IsWanted(const std::string& filePath) const
+{
+	return m_extensions.contains(fs::path(filePath).extension().string());
+}
+
+void DirectoryWatcher::Run(const FileHandler& onChanged, const FileHandler& onRemoved, const std::function<void()>& onTick, const std::atomic<bool>& isStopRequested)
+{
+	std::vector<char> buffer(EVENTS_BUFFER_SIZE);
+	pollfd pollFd{m_fd, POLLIN, 0};
+
+	while (!isStopRequested)
+	{
+		onTick();
+		const int ready = poll(&pollFd, 1, POLL_TIMEOUT_MS);
+		if (ready < 0 && errno != EINTR)
+		{
+			throw std::runtime_error("Ошибка ожидания событий inotify");
+		}
+		if (ready <= 0)
+		{
+			continue;
+		}
+
+		const ssize_t size = read(m_fd, buffer.data(), buffer.size());
+		if (size < 0 && (errno == EAGAIN || errno == EINTR))
+		{
+			continue;
+		}
+		if (size < 0)
+		{
+			throw std::runtime_error("Ошибка чтения событий inotify");
+		}
+		HandleEvents(buffer.data(), static_cast<size_t>(size), onChanged, onRemoved);
+	}
+}
+
+void DirectoryWatcher::HandleEvents(const char* buffer, size_t size, const FileHandler& onChanged, const FileHandler& onRemoved)
+{
+	for (size_t offset = 0; offset < size;)
+	{
+		const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+		offset += sizeof(inotify_event) + event->len;
+
+		// Очередь ядра переполнилась и события потеряны: удаленное находится
+		// по известным файлам, а новое - повторным обходом всего дерева,
+		// лишняя обработка безвредна
+		if (event->mask & IN_Q_OVERFLOW)
+		{
+			ReconcileRemoved(onRemoved);
+			AddWatchTree(m_dirPath);
+			DirectoryScanner::Walk(m_dirPath, m_extensions, false, onChanged);
+			continue;
+		}
+		if (event->mask & IN_IGNORED)
+		{
+			m_dirs.erase(event->wd);
+			continue;
+		}
+
+		const auto dir = m_dirs.find(event->wd);
+		if (dir == m_dirs.end() || event->len == 0)
+		{
+			continue;
+		}
+		const std::string path = JoinPath(dir->second.path, event->name);
+
+		if (event->mask & IN_ISDIR)
+		{
+			// Файлы могли появиться в каталоге раньше, чем на него подписались
+			if (event->mask & (IN_CREATE | IN_MOVED_TO))
+			{
+				AddWatchTree(path);
+				DirectoryScanner::Walk(path, m_extensions, false, onChanged);
+			}
+			// Из перенесенного из дерева каталога событий о файлах не будет.
+			// При удалении файлы обычно уже сообщены по одному
+			else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+			{
+				RemoveWatchTree(path, onRemoved);
+			}
+		}
+		else if (IsWanted(path))
+		{
+			if (event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO))
+			{
+				dir->second.files.insert(event->name);
+				onChanged(path);
+			}
+			else if (event->mask & (IN_DELETE | IN_MOVED_FROM))
+			{
+				dir->second.files.erase(event->name);
+				onRemoved(path);
+			}
+		}
+	}
+}
\ No newline at end of file
@@ -0,0 +1,55 @@
+#pragma once
+
+#include "DirectoryScanner.h"
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+// Слежение за деревом каталогов через inotify. Файл считается готовым после
+// IN_CLOSE_WRITE или IN_MOVED_TO; новые подкаталоги сразу берутся под
+// наблюдение, а уже лежащие в них файлы отдаются как измененные. Удаление и
+// перенос файла из дерева сообщаются отдельно, в том числе для всех файлов
+// каталога, перенесенного из дерева: для этого наблюдатель помнит нужные
+// файлы каждого каталога.
+class DirectoryWatcher
+{
+public:
+	using FileHandler = DirectoryScanner::FileHandler;
+
+	// Подписка оформляется в конструкторе, поэтому файлы, появившиеся во
+	// время начального обхода, придут событиями и не потеряются
+	DirectoryWatcher(const std::string& dirPath, const std::unordered_set<std::string>& extensions);
+	~DirectoryWatcher();
+
+	DirectoryWatcher(const DirectoryWatcher&) = delete;
+	DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+
+	// Обрабатывает события, пока не будет выставлен isStopRequested. onTick
+	// вызывается в этом же потоке перед каждым ожиданием событий, то есть не
+	// реже, чем раз в интервал опроса
+	void Run(const FileHandler& onChanged, const FileHandler& onRemoved, const std::function<void()>& onTick, const std::atomic<bool>& isStopRequested);
+
+private:
+	struct WatchedDir
+	{
+		std::string path;
+		// Имена нужных файлов, о которых известно наблюдателю
+		std::unordered_set<std::string> files;
+	};
+
+	int AddWatch(const std::string& dirPath);
+	void AddWatchTree(const std::string& dirPath);
+	void RemoveWatchTree(const std::string& dirPath, const FileHandler& onRemoved);
+	// После переполнения очереди: удаленные за это время файлы и каталоги
+	void ReconcileRemoved(const FileHandler& onRemoved);
+	void HandleEvents(const char* buffer, size_t size, const FileHandler& onChanged, const FileHandler& onRemoved);
+	bool IsWanted(const std::string& filePath) const;
+
+	int m_fd;
+	std::string m_dirPath;
+	std::unordered_set<std::string> m_extensions;
+	std::unordered_map<int, WatchedDir> m_dirs;
+};
\ No newline at end of file
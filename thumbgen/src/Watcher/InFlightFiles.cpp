@@ -0,0 +1,51 @@
+#include "InFlightFiles.h"
+
+#include <utility>
+
+bool InFlightFiles::TryStart(const std::string& filePath)
+{
+	std::lock_guard lock(m_mutex);
+	const auto [it, isInserted] = m_files.try_emplace(filePath, Pending::None);
+	if (!isInserted)
+	{
+		it->second = Pending::Restart;
+	}
+	return isInserted;
+}
+
+bool InFlightFiles::TryRemove(const std::string& filePath)
+{
+	std::lock_guard lock(m_mutex);
+	const auto it = m_files.find(filePath);
+	if (it == m_files.end())
+	{
+		return true;
+	}
+	it->second = Pending::Remove;
+	return false;
+}
+
+InFlightFiles::Action InFlightFiles::Finish(const std::string& filePath)
+{
+	std::lock_guard lock(m_mutex);
+	const auto it = m_files.find(filePath);
+	if (it == m_files.end())
+	{
+		return Action::None;
+	}
+	const Pending pending = it->second;
+	m_files.erase(it);
+	// Повторную задачу ставит поток слежения: рабочий поток не должен ждать
+	// места в очереди, которое сам же занимает
+	if (pending == Pending::Restart)
+	{
+		m_restarts.push_back(filePath);
+	}
+	return pending == Pending::Remove ? Action::Remove : Action::None;
+}
+
+std::vector<std::string> InFlightFiles::TakeRestarts()
+{
+	std::lock_guard lock(m_mutex);
+	return std::exchange(m_restarts, {});
+}
\ No newline at end of file
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Файлы, задачи которых сейчас в работе, в режиме слежения. У файла не
+// бывает двух задач сразу: изменение во время обработки откладывает повторную
+// обработку до ее конца, а удаление - уборку миниатюр. Иначе устаревшая
+// задача могла бы записать результат поверх свежего или уже после удаления.
+class InFlightFiles
+{
+public:
+	enum class Action
+	{
+		None,
+		// Файл удален, пока был в работе: миниатюры надо убрать
+		Remove,
+	};
+
+	// false - файл уже в работе и будет обработан заново после нее
+	bool TryStart(const std::string& filePath);
+	// false - файл в работе, уборку миниатюр вернет Finish
+	bool TryRemove(const std::string& filePath);
+	// Задача файла завершилась. Отложенная повторная обработка попадает в
+	// TakeRestarts
+	Action Finish(const std::string& filePath);
+	// Файлы, которые пора снова поставить в обработку
+	std::vector<std::string> TakeRestarts();
+
+private:
+	enum class Pending
+	{
+		None,
+		Restart,
+		Remove,
+	};
+
+	std::mutex m_mutex;
+	std::unordered_map<std::string, Pending> m_files;
+	std::vector<std::string> m_restarts;
+};
\ No newline at end of file